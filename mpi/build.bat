@@ -21,10 +21,16 @@ pause
 exit /b 1
 
 :build_with_cl
+REM Generate the constant placement tables (tables.h)
+cl /O2 /std:c11 /nologo gen_tables.c init.c /Fe:gen_tables.exe
+if %ERRORLEVEL% NEQ 0 goto :failed
+gen_tables.exe > tables.h
+if %ERRORLEVEL% NEQ 0 goto :failed
+
 REM Maximum optimization equivalent to: gcc -O3 -march=native -flto -pipe -std=c11
-cl /O2 /Ox /Oi /Ot /Oy /GL /GS- /DNDEBUG /std:c11 /favor:INTEL64 ^
+cl /O2 /Ox /Oi /Ot /Oy /GL /GS- /DNDEBUG /DIQ_STATIC_TABLES /std:c11 /favor:INTEL64 ^
    /I"C:\Program Files (x86)\Microsoft SDKs\MPI\Include" ^
-   iq_mpi.c init.c ^
+   iq_mpi.c init.c worklist.c solfile.c iqfit.c checkpoint.c ^
    /link /LTCG /OPT:REF /OPT:ICF ^
    /LIBPATH:"C:\Program Files (x86)\Microsoft SDKs\MPI\Lib\x64" ^
    msmpi.lib /OUT:iq_mpi.exe
@@ -32,8 +38,12 @@ cl /O2 /Ox /Oi /Ot /Oy /GL /GS- /DNDEBUG /std:c11 /favor:INTEL64 ^
 if %ERRORLEVEL% EQU 0 (
     echo SUCCESS! Created: iq_mpi.exe
     echo To run: mpiexec -n 4 iq_mpi.exe
-) else (
-    echo BUILD FAILED!
-    echo Ensure MS-MPI SDK is installed.
+    goto :done
 )
+
+:failed
+echo BUILD FAILED!
+echo Ensure MS-MPI SDK is installed.
+
+:done
 pause
\ No newline at end of file
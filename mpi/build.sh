@@ -0,0 +1,18 @@
+#!/bin/sh
+# Linux build against Open MPI or MPICH (the counterpart of build.bat).
+# CC=<wrapper> selects another MPI compiler wrapper, default mpicc.
+set -e
+cd "$(dirname "$0")"
+CC=${CC:-mpicc}
+
+echo "Building MPI IQ Solver..."
+
+# Generate the constant placement tables (tables.h)
+cc -O2 -std=c11 gen_tables.c init.c -o gen_tables
+./gen_tables > tables.h
+
+$CC -O3 -march=native -flto -pipe -std=c11 -pthread -DNDEBUG -DIQ_STATIC_TABLES \
+    iq_mpi.c init.c worklist.c solfile.c iqfit.c checkpoint.c -o iq_mpi
+
+echo "SUCCESS! Created: iq_mpi"
+echo "To run: mpirun -n 4 ./iq_mpi"
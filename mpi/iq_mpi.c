@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200809L        /* clock_gettime() under -std=c11 */
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,19 +7,10 @@
 #include <string.h>
 #include <time.h>
 #include "init.h"
-
-#ifdef _MSC_VER
-#include <intrin.h>
-#pragma intrinsic(_BitScanForward64)
-
-static inline int ctzll(uint64_t x) {
-    if (x == 0) return 64;
-    unsigned long index;
-    _BitScanForward64(&index, x);
-    return (int)index;
-}
-#define __builtin_ctzll(x) ctzll(x)
-#endif
+#include "worklist.h"
+#include "solfile.h"
+#include "iqfit.h"
+#include "checkpoint.h"
 
 #ifdef _WIN32
   #include <windows.h>
@@ -39,141 +31,137 @@ static inline int ctzll(uint64_t x) {
       ts->tv_nsec = (long)((count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart);
       return 0;
   }
-#endif
-
-static uint64_t neighbor_masks[BOARD_CELLS];
-static uint64_t FULL_MASK;
 
-static int *placements_by_cell[BOARD_CELLS];
-static int  placements_by_cell_cnt[BOARD_CELLS];
-
-static uint8_t *idx_pid;
+  typedef HANDLE  thread_t;
+  typedef SRWLOCK lock_t;
+  #define LOCK_INITIALIZER SRWLOCK_INIT
+  #define lock_acquire(l)  AcquireSRWLockExclusive(l)
+  #define lock_release(l)  ReleaseSRWLockExclusive(l)
+#else
+  #include <pthread.h>
+  typedef pthread_t       thread_t;
+  typedef pthread_mutex_t lock_t;
+  #define LOCK_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+  #define lock_acquire(l)  pthread_mutex_lock(l)
+  #define lock_release(l)  pthread_mutex_unlock(l)
+#endif
 
-static inline int orphan_1x1(uint64_t occ)
+/* This rank's share of the solutions: the callback context of its solver. */
+typedef struct {
+    FILE     *fp;                       /* --merge: this rank's temp file */
+    uint16_t (*ids)[NUM_PIECES];        /* otherwise kept for write_shared() */
+    size_t    n, cap;
+    uint64_t  sol_written;
+    uint64_t  sym_counted;
+} Output;
+
+static int       count_only  = 0;
+static int       binary_out  = 0;
+static int       canonical_out = 0;
+static int       merge_out   = 0;
+static int       ckpt_every  = 0;       /* seconds between checkpoints */
+static int       nthreads    = 1;       /* search threads per rank */
+
+/* The canonical solution and its distinct mirror images and rotation, or
+   with --canonical the canonical solution alone. */
+static int output_variants(const uint16_t id[NUM_PIECES], int sym[4])
 {
-    for (int p = 0; p < BOARD_CELLS; ++p) {
-        if (!(occ & (1ULL << p)) &&
-            (neighbor_masks[p] & occ) == neighbor_masks[p]) {
-            return 1;
-        }
-    }
-    return 0;
+    if (canonical_out) { sym[0] = SYM_ID; return 1; }
+    return solution_variants_ids(id, sym);
 }
-#define SHOULD_PRUNE(m)  orphan_1x1(m)
-
-static FILE     *fp_out;
-static uint64_t  sol_written = 0;
 
-static void dump_solution(char board[])
+/* Ranks keep the place[] indices of their canonical solutions; the
+   symmetric variants are expanded only when the output is written. */
+static void emit_ids(Output *o, const uint64_t occ_piece[NUM_PIECES])
 {
-    ++sol_written;
-    fprintf(fp_out, "Solution %" PRIu64 ":\n", sol_written);
-    for (int r = 0; r < BOARD_H; ++r) {
-        for (int c = 0; c < BOARD_W; ++c) {
-            fputc(board[r * BOARD_W + c], fp_out);
-            fputc(' ', fp_out);
+    uint16_t rec[NUM_PIECES];
+    solution_ids(occ_piece, rec);
+    ++o->sol_written;
+    if (o->fp) {
+        fwrite(rec, sizeof rec, 1, o->fp);
+        return;
+    }
+    if (o->n == o->cap) {
+        o->cap = o->cap ? 2 * o->cap : 4096;
+        o->ids = realloc(o->ids, o->cap * sizeof *o->ids);
+        if (!o->ids) {
+            fprintf(stderr, "Out of memory buffering solutions\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
         }
-        fputc('\n', fp_out);
     }
-    fputs("==========\n", fp_out);
+    memcpy(o->ids[o->n++], rec, sizeof rec);
 }
 
-static void emit(uint64_t occ_piece[NUM_PIECES])
+static int solution(void *ctx, const uint64_t occ_piece[NUM_PIECES])
 {
-    char B[BOARD_CELLS];
-
-    memset(B, '.', BOARD_CELLS);
-    for (int pid = 0; pid < NUM_PIECES; ++pid) {
-        uint64_t m = occ_piece[pid];
-        while (m) {
-            int b = __builtin_ctzll(m);
-            B[b] = piece_sym[pid];
-            m &= m - 1;
-        }
+    Output *o = ctx;
+    if (count_only) {
+        ++o->sol_written;
+        o->sym_counted += solution_multiplicity(occ_piece);
+    } else {
+        emit_ids(o, occ_piece);
     }
-    dump_solution(B);
+    return 0;
 }
 
-
-static void dfs(uint64_t occ, uint32_t used_mask,
-                uint64_t occ_piece[NUM_PIECES], int depth)
+/* Reads back the solutions a checkpointed rank kept on disk, for
+   write_shared(). The file stays until the output is safely written; see
+   remove_rank_file(). */
+static void load_ids(Output *o, int rank)
 {
-    if (SHOULD_PRUNE(occ)) return;
-
-    if (used_mask == (1u << NUM_PIECES) - 1) {
-        emit(occ_piece);
-        return;
+    char fname[64];
+    snprintf(fname, sizeof(fname), "solutions_%d.bin", rank);
+    FILE *in = fopen(fname, "rb");
+    o->cap = o->sol_written ? o->sol_written : 1;
+    o->ids = malloc(o->cap * sizeof *o->ids);
+    if (!in || !o->ids) {
+        fprintf(stderr, "[Rank %d] Unable to read %s\n", rank, fname);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    o->n = fread(o->ids, sizeof *o->ids, o->cap, in);
+    fclose(in);
+    if (o->n != o->sol_written)
+        fprintf(stderr, "[Rank %d] Warning: %s holds %zu of %" PRIu64
+                " solutions\n", rank, fname, o->n, o->sol_written);
+}
 
-    int first = __builtin_ctzll(~occ & FULL_MASK);
-
-    int *lst = placements_by_cell[first];
-    int  cnt = placements_by_cell_cnt[first];
-
-    for (int k = 0; k < cnt; ++k) {
-        int idx = lst[k];
-        int pid = idx_pid[idx];
-        if (used_mask & (1u << pid)) continue;
-
-        uint64_t pmask = place[idx].mask;
-        if (pmask & occ) continue;
+/* Deletes this rank's solutions_<rank>.bin. Only called once the final
+   output is on disk and no checkpoint refers to the file any more, so a
+   run killed during the output phase can still resume. */
+static void remove_rank_file(int rank)
+{
+    char fname[64];
+    snprintf(fname, sizeof(fname), "solutions_%d.bin", rank);
+    if (remove(fname) != 0)
+        fprintf(stderr, "[Rank %d] Warning: Could not delete %s\n", rank, fname);
+}
 
-        occ_piece[pid] = pmask;
-        dfs(occ | pmask, used_mask | (1u << pid), occ_piece, depth + 1);
-        occ_piece[pid] = 0;
+/* Writes the solutions a threaded rank gathered for --merge. */
+static void store_ids(const Output *o, int rank)
+{
+    char fname[64];
+    snprintf(fname, sizeof(fname), "solutions_%d.bin", rank);
+    FILE *f = fopen(fname, "wb");
+    if (!f || fwrite(o->ids, sizeof *o->ids, o->n, f) != o->n) {
+        fprintf(stderr, "[Rank %d] Unable to write %s\n", rank, fname);
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    fclose(f);
 }
 
-static void build_tables(void)
+/* Text of one board, as write_board_to_file() prints it. */
+static char *format_board(char *p, uint64_t n, const char board[])
 {
-    FULL_MASK = (BOARD_CELLS == 64)
-                ? ~0ULL
-                : ((1ULL << BOARD_CELLS) - 1);
-
+    p += sprintf(p, "Solution %" PRIu64 ":\n", n);
     for (int r = 0; r < BOARD_H; ++r) {
         for (int c = 0; c < BOARD_W; ++c) {
-            int bit = r * BOARD_W + c;
-            uint64_t N = 0;
-            if (r)              N |= 1ULL << (bit - BOARD_W);
-            if (r + 1 < BOARD_H) N |= 1ULL << (bit + BOARD_W);
-            if (c)            N |= 1ULL << (bit - 1);
-            if (c + 1 < BOARD_W) N |= 1ULL << (bit + 1);
-            neighbor_masks[bit] = N;
-        }
-    }
-
-    idx_pid = malloc(place_cnt);
-    for (int pid = 0; pid < NUM_PIECES; ++pid) {
-        for (int i = p_first[pid]; i < p_first[pid] + p_count[pid]; ++i) {
-            idx_pid[i] = pid;
-        }
-    }
-
-    memset(placements_by_cell_cnt, 0,
-           sizeof(placements_by_cell_cnt));
-    for (int idx = 0; idx < place_cnt; ++idx) {
-        uint64_t m = place[idx].mask;
-        while (m) {
-            int b = __builtin_ctzll(m);
-            ++placements_by_cell_cnt[b];
-            m &= m - 1;
-        }
-    }
-    for (int b = 0; b < BOARD_CELLS; ++b) {
-        placements_by_cell[b] = malloc(
-            placements_by_cell_cnt[b] * sizeof(int));
-        placements_by_cell_cnt[b] = 0;
-    }
-
-    for (int idx = 0; idx < place_cnt; ++idx) {
-        uint64_t m = place[idx].mask;
-        while (m) {
-            int b = __builtin_ctzll(m);
-            placements_by_cell[b][
-                placements_by_cell_cnt[b]++] = idx;
-            m &= m - 1;
+            *p++ = board[r * BOARD_W + c];
+            *p++ = ' ';
         }
+        *p++ = '\n';
     }
+    memcpy(p, "==========\n", 11);
+    return p + 11;
 }
 
 static void write_board_to_file(FILE *f, char board[], uint64_t *counter) {
@@ -189,7 +177,7 @@ static void write_board_to_file(FILE *f, char board[], uint64_t *counter) {
     fputs("==========\n", f);
 }
 
-static void merge_generate_and_cleanup(int nprocs, double elapsed_time)
+static void merge_text(int nprocs)
 {
     FILE *out = fopen("solutions.txt", "w");
     if (!out) {
@@ -198,123 +186,677 @@ static void merge_generate_and_cleanup(int nprocs, double elapsed_time)
     }
 
     uint64_t total_solutions_written = 0;
-    char line[256];
     char fname[64];
-    char current_board[BOARD_CELLS];
-    int board_row = 0;
+    uint16_t rec[NUM_PIECES];
+    char board[BOARD_CELLS];
 
     for (int r_idx = 0; r_idx < nprocs; ++r_idx) {
-        snprintf(fname, sizeof(fname), "solutions_%d.txt", r_idx);
-        FILE *in = fopen(fname, "r");
+        snprintf(fname, sizeof(fname), "solutions_%d.bin", r_idx);
+        FILE *in = fopen(fname, "rb");
         if (!in) continue;
 
-        while (fgets(line, sizeof(line), in)) {
-            if (strncmp(line, "Solution ", 9) == 0) {
-                board_row = 0;
-            } else if (strncmp(line, "==========", 10) == 0) {
-                char B_h_mir[BOARD_CELLS], B_v_mir[BOARD_CELLS], B_180_rot[BOARD_CELLS];
-
-                for (int r = 0; r < BOARD_H; ++r) {
-                    for (int c = 0; c < BOARD_W; ++c) {
-                        B_h_mir[r * BOARD_W + c] = current_board[r * BOARD_W + (BOARD_W - 1 - c)];
-                        B_v_mir[r * BOARD_W + c] = current_board[(BOARD_H - 1 - r) * BOARD_W + c];
-                        B_180_rot[r * BOARD_W + c] = current_board[(BOARD_H - 1 - r) * BOARD_W + (BOARD_W - 1 - c)];
-                    }
-                }
-                
-                write_board_to_file(out, current_board, &total_solutions_written);
-                if (memcmp(current_board, B_h_mir, BOARD_CELLS) != 0) write_board_to_file(out, B_h_mir, &total_solutions_written);
-                if (memcmp(current_board, B_v_mir, BOARD_CELLS) != 0 && memcmp(B_h_mir, B_v_mir, BOARD_CELLS) != 0) write_board_to_file(out, B_v_mir, &total_solutions_written);
-                if (memcmp(current_board, B_180_rot, BOARD_CELLS) != 0 && memcmp(B_h_mir, B_180_rot, BOARD_CELLS) != 0 && memcmp(B_v_mir, B_180_rot, BOARD_CELLS) != 0) write_board_to_file(out, B_180_rot, &total_solutions_written);
-
-            } else if (board_row < BOARD_H) {
-                for (int c = 0; c < BOARD_W; ++c) {
-                    current_board[board_row * BOARD_W + c] = line[c * 2];
-                }
-                board_row++;
+        while (fread(rec, sizeof(uint16_t), NUM_PIECES, in) == NUM_PIECES) {
+            int sym[4];
+            int n = output_variants(rec, sym);
+            for (int i = 0; i < n; ++i) {
+                solution_board(rec, sym[i], board);
+                write_board_to_file(out, board, &total_solutions_written);
             }
         }
         fclose(in);
-        if (remove(fname) != 0) {
-            fprintf(stderr, "[Rank 0] Warning: Could not delete %s\n", fname);
+    }
+
+    uint64_t bytes;
+    if (ckpt_every && ckpt_sync(out, &bytes) != 0) {
+        perror("[Rank 0] solutions");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    fclose(out);
+
+    printf("\n=== FINAL RESULTS ===\n");
+    printf("Total solutions found (%s): %" PRIu64 "\n",
+           canonical_out ? "canonical only" : "all symmetries",
+           total_solutions_written);
+}
+
+static void merge_binary(int nprocs)
+{
+    FILE *out = fopen("solutions.bin", "wb");
+    if (!out) {
+        fprintf(stderr, "[Rank 0] Unable to create solutions.bin\n");
+        return;
+    }
+    solfile_write_header(out, 0);
+
+    uint64_t total_solutions_written = 0;
+    char fname[64];
+    uint16_t rec[NUM_PIECES + 1];
+
+    for (int r_idx = 0; r_idx < nprocs; ++r_idx) {
+        snprintf(fname, sizeof(fname), "solutions_%d.bin", r_idx);
+        FILE *in = fopen(fname, "rb");
+        if (!in) continue;
+
+        while (fread(rec, sizeof(uint16_t), NUM_PIECES, in) == NUM_PIECES) {
+            int sym[4];
+            int n = output_variants(rec, sym);
+            for (int i = 0; i < n; ++i) {
+                rec[NUM_PIECES] = (uint16_t)sym[i];
+                fwrite(rec, sizeof rec, 1, out);
+            }
+            total_solutions_written += n;
         }
+        fclose(in);
     }
 
+    solfile_set_count(out, total_solutions_written);
+    uint64_t bytes;
+    if (ckpt_every && ckpt_sync(out, &bytes) != 0) {
+        perror("[Rank 0] solutions");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
     fclose(out);
-    
+
     printf("\n=== FINAL RESULTS ===\n");
-    printf("Total solutions found (all symmetries): %" PRIu64 "\n", total_solutions_written);
+    printf("Total solutions found (%s): %" PRIu64 "\n",
+           canonical_out ? "canonical only" : "all symmetries",
+           total_solutions_written);
+}
+
+/* Every text board is TEXT_BOARD bytes plus the digits of its number. */
+#define TEXT_BOARD       (sizeof "Solution :\n" - 1 + BOARD_H * (2 * BOARD_W + 1) + 11)
+#define TEXT_BOARD_MAX   (TEXT_BOARD + 20)
+#define BIN_RECORD       ((NUM_PIECES + 1) * sizeof(uint16_t))
+#define IO_CHUNK         (4u << 20)
+
+/* Bytes of the text of boards 1..n. */
+static uint64_t text_bytes(uint64_t n)
+{
+    uint64_t bytes = n * TEXT_BOARD;
+    for (uint64_t lo = 1, digits = 1; lo <= n; lo *= 10, ++digits) {
+        uint64_t hi = n / 10 < lo ? n : 10 * lo - 1;
+        bytes += (hi - lo + 1) * digits;
+    }
+    return bytes;
+}
+
+/* Every rank writes its boards straight into the shared output file. An
+   exclusive prefix sum of the board counts numbers them as the merge
+   would, in rank order, which fixes each rank's byte offset; the file is
+   then written in rounds of collective writes of up to IO_CHUNK bytes per
+   rank. Returns the number of boards in the file. */
+static uint64_t write_shared(const Output *o, int rank)
+{
+    const char *path = binary_out ? "solutions.bin" : "solutions.txt";
+    uint64_t boards = 0, first = 0, total = 0;
+    int sym[4];
+
+    for (size_t i = 0; i < o->n; ++i) boards += output_variants(o->ids[i], sym);
+    MPI_Exscan(&boards, &first, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+               MPI_COMM_WORLD);
+    if (rank == 0) first = 0;           /* MPI_Exscan leaves rank 0's undefined */
+    MPI_Allreduce(&boards, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        fprintf(stderr, "[Rank %d] Unable to create %s\n", rank, path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Offset header = binary_out ? (MPI_Offset)solfile_header_size() : 0;
+    MPI_Offset size   = binary_out ? header + (MPI_Offset)(total * BIN_RECORD)
+                                   : (MPI_Offset)text_bytes(total);
+    MPI_Offset off    = binary_out ? header + (MPI_Offset)(first * BIN_RECORD)
+                                   : (MPI_Offset)text_bytes(first);
+    MPI_File_set_size(fh, size);
+
+    char *buf = malloc(IO_CHUNK);
+    char  board[BOARD_CELLS];
+    if (!buf) {
+        fprintf(stderr, "[Rank %d] Out of memory\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (binary_out && rank == 0) {
+        solfile_header_image(buf, total);
+        MPI_File_write_at(fh, 0, buf, (int)header, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    uint64_t num = first;
+    size_t i = 0;
+    int more;
+    do {
+        char *p = buf;
+        /* whole solutions only: room for all four variants */
+        while (i < o->n && (size_t)(buf + IO_CHUNK - p) >= 4 * TEXT_BOARD_MAX) {
+            int n = output_variants(o->ids[i], sym);
+            for (int k = 0; k < n; ++k) {
+                if (binary_out) {
+                    uint16_t rec[NUM_PIECES + 1];
+                    memcpy(rec, o->ids[i], NUM_PIECES * sizeof(uint16_t));
+                    rec[NUM_PIECES] = (uint16_t)sym[k];
+                    memcpy(p, rec, sizeof rec);
+                    p += sizeof rec;
+                } else {
+                    solution_board(o->ids[i], sym[k], board);
+                    p = format_board(p, ++num, board);
+                }
+            }
+            ++i;
+        }
+        MPI_File_write_at_all(fh, off, buf, (int)(p - buf), MPI_BYTE,
+                              MPI_STATUS_IGNORE);
+        off += p - buf;
+
+        int mine = i < o->n;
+        MPI_Allreduce(&mine, &more, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    } while (more);
+
+    if (ckpt_every) MPI_File_sync(fh);
+    MPI_File_close(&fh);
+    free(buf);
+    return total;
+}
+
+#define TAG_WORK_REQ     1
+#define TAG_WORK         2
+
+static PrefixList prefixes;
+static IqSolver  *solver;
+
+/* Each rank checkpoints its own progress to checkpoint_<rank>.txt: the
+   prefixes it has finished, the size of its solutions_<rank>.bin and its
+   counters. */
+static Checkpoint ckpt;
+static char       ckpt_path[64];
+static double     ckpt_last;
+static uint64_t   nodes_before;         /* searched before the resume */
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void save_checkpoint(Output *o)
+{
+    if (o->fp && ckpt_sync(o->fp, &ckpt.out_bytes) != 0) {
+        fprintf(stderr, "Warning: %s not saved\n", ckpt_path);
+        return;
+    }
+    ckpt.canon   = o->sol_written;
+    ckpt.written = o->sym_counted;
+    ckpt.nodes   = nodes_before + iq_solver_nodes(solver);
+    ckpt_save(&ckpt, ckpt_path);
+}
+
+/* Marks prefix k finished; saves at most every ckpt_every seconds. */
+static void prefix_done(Output *o, int k)
+{
+    if (!ckpt_every) return;
+    ckpt.done[k] = 1;
+    double t = now_sec();
+    if (t - ckpt_last < ckpt_every) return;
+    ckpt_last = t;
+    save_checkpoint(o);
+}
+
+/* One search thread of a rank. Each has its own solver and keeps its own
+   solutions; only the placement tables are shared. */
+typedef struct {
+    IqSolver *solver;
+    Output   *out;
+    int       done;                     /* prefixes searched */
+    thread_t  tid;
+} Worker;
+
+/* Where the solutions of prefix k went, so that a threaded rank can lay
+   them out in prefix order, as a single thread would have found them. */
+typedef struct {
+    int    worker;
+    size_t begin, end;
+} Segment;
+
+static Worker  *workers;
+static Segment *segs;
+static int      work_depth;
+
+/* The threads of a rank share one source of prefixes: its own indices in
+   mine[] (static), rank 0 (dynamic) or, on rank 0, the coordinator's
+   counter. A prefix is searched by whichever thread takes it first. */
+static lock_t   work_lock = LOCK_INITIALIZER;
+static int     *mine;
+static int      mine_cnt;
+static int      work_next;
+static int      dynamic_work;           /* ask rank 0 for prefixes */
+static int      coordinator;            /* this is rank 0 of a dynamic run */
+static int      work_over;              /* rank 0 has no more */
+
+/* Rank 0 only hands out prefix indices; every rank enumerates the same
+   prefix list, so a work item is a single int (-1 means no more work).
+   On resume, ckpt.done holds the prefixes finished by any rank. */
+static int take_prefix(void)
+{
+    lock_acquire(&work_lock);
+    if (ckpt_every)
+        while (work_next < prefixes.cnt && ckpt.done[work_next]) ++work_next;
+    int item = (work_next < prefixes.cnt) ? work_next++ : -1;
+    lock_release(&work_lock);
+    return item;
+}
+
+static void coordinate(int nprocs)
+{
+    int active = nprocs - 1;
+
+    while (active > 0) {
+        int dummy;
+        MPI_Status st;
+        MPI_Recv(&dummy, 1, MPI_INT, MPI_ANY_SOURCE, TAG_WORK_REQ,
+                 MPI_COMM_WORLD, &st);
+
+        int item = take_prefix();
+        if (item < 0) --active;
+        MPI_Send(&item, 1, MPI_INT, st.MPI_SOURCE, TAG_WORK, MPI_COMM_WORLD);
+    }
+}
+
+/* Threads of other ranks take turns asking rank 0, so MPI needs only
+   MPI_THREAD_SERIALIZED; the first -1 ends the rank's work. */
+static int next_prefix(void)
+{
+    if (coordinator) return take_prefix();
+
+    int item = -1;
+    lock_acquire(&work_lock);
+    if (!dynamic_work) {
+        if (work_next < mine_cnt) item = mine[work_next++];
+    } else if (!work_over) {
+        int dummy = 0;
+        MPI_Send(&dummy, 1, MPI_INT, 0, TAG_WORK_REQ, MPI_COMM_WORLD);
+        MPI_Recv(&item, 1, MPI_INT, 0, TAG_WORK, MPI_COMM_WORLD,
+                 MPI_STATUS_IGNORE);
+        work_over = item < 0;
+    }
+    lock_release(&work_lock);
+    return item;
+}
+
+static void *search_prefixes(void *arg)
+{
+    Worker *w = arg;
+    int k;
+    while ((k = next_prefix()) >= 0) {
+        if (segs) segs[k] = (Segment){ (int)(w - workers), w->out->n, 0 };
+        iq_solve_prefix(w->solver, prefixes.items[k].idx, work_depth);
+        if (segs) segs[k].end = w->out->n;
+        prefix_done(w->out, k);
+        ++w->done;
+    }
+    return NULL;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI thread_main(LPVOID arg) { search_prefixes(arg); return 0; }
+static void thread_start(Worker *w) { w->tid = CreateThread(NULL, 0, thread_main, w, 0, NULL); }
+static void thread_join(Worker *w)  { WaitForSingleObject(w->tid, INFINITE); CloseHandle(w->tid); }
+#else
+static void thread_start(Worker *w) { pthread_create(&w->tid, NULL, search_prefixes, w); }
+static void thread_join(Worker *w)  { pthread_join(w->tid, NULL); }
+#endif
+
+/* Adds the other threads' counters and solutions to workers[0], the
+   rank's own Output, with the solutions in prefix order. */
+static void gather(int nprefixes)
+{
+    Output *out = workers[0].out;
+    size_t total = 0;
+    for (int w = 0; w < nthreads; ++w) total += workers[w].out->n;
+
+    uint16_t (*ids)[NUM_PIECES] = malloc((total ? total : 1) * sizeof *ids);
+    if (!ids) {
+        fprintf(stderr, "Out of memory gathering solutions\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    size_t n = 0;
+    for (int k = 0; k < nprefixes; ++k) {
+        if (segs[k].worker < 0) continue;
+        const Output *o = workers[segs[k].worker].out;
+        memcpy(ids[n], o->ids[segs[k].begin],
+               (segs[k].end - segs[k].begin) * sizeof *ids);
+        n += segs[k].end - segs[k].begin;
+    }
+
+    for (int w = 1; w < nthreads; ++w) {
+        out->sol_written += workers[w].out->sol_written;
+        out->sym_counted += workers[w].out->sym_counted;
+        free(workers[w].out->ids);
+    }
+    free(out->ids);
+    out->ids = ids;
+    out->n = out->cap = n;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--binary | --count-only] [--canonical] [--merge]\n"
+            "          [--prune-regions] [--dynamic]\n"
+            "          [--branch lowest|constrained]\n"
+            "          [--depth <1-%d> | --worklist <file> [--shard <n>]]\n"
+            "          [--checkpoint <seconds>] [--resume] [--threads <n>]\n",
+            prog, MAX_PREFIX_DEPTH);
 }
 
 int main(int argc, char **argv)
 {
-    int rank, nprocs;
-    MPI_Init(&argc, &argv);
+    int rank, nprocs, provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
     MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    init_all();
-    build_tables();
+    IqOptions opts = {0};
+    int dynamic = 0;
+    int depth = 3;
+    int shard = -1;
+    int resume = 0;
+    const char *worklist = NULL;
+#ifdef IQ_STATS
+    const char *stats_path = "stats.json";
+#endif
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--dynamic")) {
+            dynamic = 1;
+        } else if (!strcmp(argv[i], "--depth") && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--binary")) {
+            binary_out = 1;
+        } else if (!strcmp(argv[i], "--canonical")) {
+            canonical_out = 1;
+        } else if (!strcmp(argv[i], "--checkpoint") && i + 1 < argc) {
+            ckpt_every = atoi(argv[++i]);
+            if (ckpt_every < 1) {
+                depth = 0;
+                break;
+            }
+        } else if (!strcmp(argv[i], "--resume")) {
+            resume = 1;
+        } else if ((!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads")) &&
+                   i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+            if (nthreads < 1) {
+                depth = 0;
+                break;
+            }
+#ifdef IQ_STATS
+        } else if (!strcmp(argv[i], "--stats") && i + 1 < argc) {
+            stats_path = argv[++i];
+#endif
+        } else if (!strcmp(argv[i], "--merge")) {
+            merge_out = 1;
+        } else if (!strcmp(argv[i], "--count-only")) {
+            count_only = 1;
+        } else if (!strcmp(argv[i], "--prune-regions")) {
+            opts.prune_regions = 1;
+        } else if (!strcmp(argv[i], "--branch") && i + 1 < argc) {
+            ++i;
+            if (!strcmp(argv[i], "constrained")) {
+                opts.branch_constrained = 1;
+            } else if (strcmp(argv[i], "lowest")) {
+                depth = 0;
+                break;
+            }
+        } else if (!strcmp(argv[i], "--worklist") && i + 1 < argc) {
+            worklist = argv[++i];
+        } else if (!strcmp(argv[i], "--shard") && i + 1 < argc) {
+            shard = atoi(argv[++i]);
+        } else {
+            depth = 0;
+            break;
+        }
+    }
+    if (depth < 1 || depth > MAX_PREFIX_DEPTH) {
+        if (rank == 0) usage(argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+    if (resume && !ckpt_every) ckpt_every = 60;
+    if (ckpt_every && nthreads > 1) {
+        if (rank == 0) fprintf(stderr, "--checkpoint runs one thread per rank\n");
+        nthreads = 1;
+    }
+    dynamic_work = dynamic && nprocs > 1;
+    if (nthreads > 1 &&
+        provided < (dynamic_work ? MPI_THREAD_SERIALIZED : MPI_THREAD_FUNNELED)) {
+        if (rank == 0) fprintf(stderr, "The MPI library does not support threads\n");
+        MPI_Finalize();
+        return 1;
+    }
 
-    char fname[64];
-    snprintf(fname, sizeof(fname), "solutions_%d.txt", rank);
-    fp_out = fopen(fname, "w");
-    if (!fp_out) {
-        fprintf(stderr, "[Rank %d] Failed to open %s\n", rank, fname);
-        MPI_Abort(MPI_COMM_WORLD, 1);
+    const IqTables *tables = iq_tables();
+
+    /* prefix enumeration follows the same pruning */
+    prune_regions = opts.prune_regions;
+    branch_constrained = opts.branch_constrained;
+    Output out = {0};
+    solver = iq_solver_create(tables, &opts, solution, &out);
+
+    if (worklist) {
+        if (read_worklist(worklist, shard, &prefixes) != 0) {
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        depth = prefixes.depth;
+    } else if (dynamic) {
+        enum_prefixes(&prefixes, depth);
+    } else {
+        /* the placements covering the first cell, round-robin */
+        int first = __builtin_ctzll(FULL_MASK);
+        prefixes.depth = depth = 1;
+        prefixes.cnt = prefixes.cap = placements_by_cell_cnt[first];
+        prefixes.items = calloc(prefixes.cnt, sizeof *prefixes.items);
+        for (int k = 0; k < prefixes.cnt; ++k)
+            prefixes.items[k].idx[0] = (uint16_t)placements_by_cell[first][k];
+    }
+
+    int loaded = 1;
+    if (ckpt_every) {
+        snprintf(ckpt_path, sizeof(ckpt_path), "checkpoint_%d.txt", rank);
+        ckpt_init(&ckpt, &prefixes,
+                  (uint32_t)nprocs << 8 | dynamic << 1 | count_only);
+        if (resume) loaded = ckpt_load(&ckpt, ckpt_path);
+        int worst;
+        MPI_Allreduce(&loaded, &worst, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+        if (worst < 0) MPI_Abort(MPI_COMM_WORLD, 1);
+        if (loaded == 0) {
+            printf("[Rank %d] Resuming from %s: %d prefixes done\n",
+                   rank, ckpt_path, ckpt_done_count(&ckpt));
+            out.sol_written = ckpt.canon;
+            out.sym_counted = ckpt.written;
+            nodes_before    = ckpt.nodes;
+        }
+        if (dynamic && nprocs > 1)
+            MPI_Reduce(rank ? ckpt.done : MPI_IN_PLACE, ckpt.done,
+                       prefixes.cnt, MPI_UNSIGNED_CHAR, MPI_MAX, 0,
+                       MPI_COMM_WORLD);
+        ckpt_last = now_sec();
+    }
+
+    /* checkpointed runs keep their solutions on disk as they go; threaded
+       ones gather them first */
+    if (!count_only && (merge_out || ckpt_every) && nthreads == 1) {
+        char fname[64];
+        snprintf(fname, sizeof(fname), "solutions_%d.bin", rank);
+        out.fp = loaded == 0 ? ckpt_reopen(fname, ckpt.out_bytes)
+                             : fopen(fname, "wb");
+        if (!out.fp) {
+            fprintf(stderr, "[Rank %d] Failed to open %s\n", rank, fname);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
     }
 
     MPI_Barrier(MPI_COMM_WORLD);
     struct timespec t0, t1;
     clock_gettime(CLOCK_MONOTONIC, &t0);
 
-    int first = __builtin_ctzll(FULL_MASK);
-    int *lst = placements_by_cell[first];
-    int  cnt  = placements_by_cell_cnt[first];
-
-    for (int k = 0; k < cnt; ++k) {
-        if ((k % nprocs) != rank) continue;
-        int idx = lst[k];
-        int pid = idx_pid[idx];
-        uint64_t pmask = place[idx].mask;
+    if (rank == 0 && (dynamic || worklist)) {
+        printf("%s scheduling: %d prefixes at depth %d\n",
+               dynamic ? "Dynamic" : "Static", prefixes.cnt, depth);
+    }
+    if (rank == 0 && nthreads > 1)
+        printf("Hybrid: %d ranks x %d threads\n", nprocs, nthreads);
+
+    /* a whole work list maps shards to ranks, a single shard is split
+       round-robin */
+    if (!dynamic_work) {
+        mine = malloc((prefixes.cnt ? prefixes.cnt : 1) * sizeof *mine);
+        for (int k = 0; k < prefixes.cnt; ++k) {
+            int owner = (worklist && shard < 0) ? prefixes.items[k].shard : k;
+            if ((owner % nprocs) == rank && !(ckpt_every && ckpt.done[k]))
+                mine[mine_cnt++] = k;
+        }
+    }
 
-        uint64_t occ_piece[NUM_PIECES] = {0};
-        occ_piece[pid] = pmask;
-        dfs(pmask, (1u << pid), occ_piece, 1);
+    workers = calloc(nthreads, sizeof *workers);
+    workers[0].solver = solver;
+    workers[0].out    = &out;
+    for (int w = 1; w < nthreads; ++w) {
+        workers[w].out    = calloc(1, sizeof *workers[w].out);
+        workers[w].solver = iq_solver_create(tables, &opts, solution,
+                                             workers[w].out);
+    }
+    if (nthreads > 1) {
+        segs = malloc((prefixes.cnt ? prefixes.cnt : 1) * sizeof *segs);
+        for (int k = 0; k < prefixes.cnt; ++k) segs[k].worker = -1;
+    }
+    work_depth = depth;
+
+    /* rank 0 of a dynamic run gives one thread (its only one by default)
+       to the coordinator */
+    coordinator = dynamic_work && rank == 0;
+    for (int w = 1; w < nthreads; ++w) thread_start(&workers[w]);
+    if (coordinator)
+        coordinate(nprocs);
+    else
+        search_prefixes(&workers[0]);
+    for (int w = 1; w < nthreads; ++w) thread_join(&workers[w]);
+
+    if (ckpt_every) save_checkpoint(&out);
+    if (dynamic_work && !(coordinator && nthreads == 1)) {
+        int done = 0;
+        for (int w = 0; w < nthreads; ++w) done += workers[w].done;
+        printf("[Rank %d] Processed %d prefixes\n", rank, done);
     }
+    if (nthreads > 1) {
+        gather(prefixes.cnt);
+        if (merge_out && !count_only) store_ids(&out, rank);
+    }
+    free(segs);
+    free(mine);
+    free_prefixes(&prefixes);
 
     clock_gettime(CLOCK_MONOTONIC, &t1);
     double local_elapsed = (t1.tv_sec - t0.tv_sec) +
                            (t1.tv_nsec - t0.tv_nsec) / 1e9;
 
+    uint64_t nodes = nodes_before;
+    for (int w = 0; w < nthreads; ++w) nodes += iq_solver_nodes(workers[w].solver);
     uint64_t canonical_count = 0;
+    uint64_t total_count = 0;
+    uint64_t total_nodes  = 0;
     double   max_elapsed  = 0.0;
-    MPI_Reduce(&sol_written, &canonical_count, 1,
+    MPI_Reduce(&out.sol_written, &canonical_count, 1,
+               MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    MPI_Reduce(&out.sym_counted, &total_count, 1,
+               MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    MPI_Reduce(&nodes, &total_nodes, 1,
                MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0,
                MPI_COMM_WORLD);
     MPI_Reduce(&local_elapsed, &max_elapsed, 1,
                MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
 
-    if (rank == 0) {
-        printf("\n=== INTERIM RESULTS ===\n");
-        printf("Canonical solutions found: %" PRIu64 "\n", canonical_count);
-        printf("Elapsed (max over ranks): %.2f s\n", max_elapsed);
-    }
-    
-
-    fclose(fp_out);
-    fp_out = NULL;
+#ifdef IQ_STATS
+    IqStats stats = {0}, stats_sum = {0};
+    for (int w = 0; w < nthreads; ++w) iq_solver_stats(workers[w].solver, &stats);
+    MPI_Reduce(&stats, &stats_sum, sizeof stats / sizeof(uint64_t),
+               MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0 && iq_stats_write(stats_path, &stats_sum) == 0)
+        printf("Search statistics written to %s\n", stats_path);
+#endif
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    if (count_only) {
+        if (!(coordinator && nthreads == 1)) {
+            printf("[Rank %d] Canonical: %" PRIu64 ", all symmetries: %" PRIu64 "\n",
+                   rank, out.sol_written, out.sym_counted);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (rank == 0) {
+            printf("\n=== FINAL RESULTS ===\n");
+            printf("Canonical solutions found: %" PRIu64 "\n", canonical_count);
+            printf("Total solutions counted (all symmetries): %" PRIu64 "\n", total_count);
+            printf("Search nodes: %" PRIu64 "\n", total_nodes);
+            printf("Elapsed (max over ranks): %.2f s\n", max_elapsed);
+        }
+    } else {
+        if (rank == 0) {
+            printf("\n=== INTERIM RESULTS ===\n");
+            printf("Canonical solutions found: %" PRIu64 "\n", canonical_count);
+            printf("Search nodes: %" PRIu64 "\n", total_nodes);
+            printf("Elapsed (max over ranks): %.2f s\n", max_elapsed);
+        }
 
-    if (rank == 0) {
-        merge_generate_and_cleanup(nprocs, max_elapsed);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (out.fp) {
+            fclose(out.fp);
+            out.fp = NULL;
+        }
+        if (merge_out) {
+            MPI_Barrier(MPI_COMM_WORLD);
+
+            if (rank == 0) {
+                if (binary_out) {
+                    merge_binary(nprocs);
+                } else {
+                    merge_text(nprocs);
+                }
+            }
+        } else {
+            if (ckpt_every) load_ids(&out, rank);
+            uint64_t total = write_shared(&out, rank);
+            if (rank == 0) {
+                printf("\n=== FINAL RESULTS ===\n");
+                printf("Total solutions found (%s): %" PRIu64 "\n",
+                       canonical_out ? "canonical only" : "all symmetries",
+                       total);
+            }
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (rank == 0) {
+            printf("Output (%s): %.2f s\n", merge_out ? "rank-0 merge" : "MPI-IO",
+                   (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+        }
+        free(out.ids);
     }
 
-    free(idx_pid);
-    for (int b = 0; b < BOARD_CELLS; ++b) {
-        free(placements_by_cell[b]);
+    if (ckpt_every) {
+        /* the run is complete, a later --resume starts over; the rank
+           files go only once no rank's checkpoint can point at them */
+        remove(ckpt_path);
+        ckpt_free(&ckpt);
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    if (!count_only && (merge_out || ckpt_every)) remove_rank_file(rank);
+    for (int w = 1; w < nthreads; ++w) {
+        iq_solver_free(workers[w].solver);
+        free(workers[w].out);
     }
+    free(workers);
+    iq_solver_free(solver);
+    iq_tables_free();
 
     MPI_Finalize();
     return 0;
@@ -0,0 +1,96 @@
+#ifndef IQFIT_H
+#define IQFIT_H
+
+#include <stdint.h>
+#include "init.h"
+
+/* libiqfit: the bitboard search behind both solvers, with every piece of
+   mutable state in a solver context. The placement tables are the
+   process-global arrays of init.h (place[], placements_by_cell[],
+   anchor_mask[], ...), which the search reads directly so that an
+   IQ_STATIC_TABLES build runs on constant data; an IqTables is only a
+   handle saying iq_tables() has built them. Nothing writes them after
+   that, so any number of solvers may run at once, one per thread. The
+   search options are per solver: libiqfit does not read the
+   prune_regions and branch_constrained globals.
+
+   A solver reports each canonical solution to a callback; it does not
+   format or write anything itself. */
+
+typedef struct IqTables IqTables;
+typedef struct IqSolver IqSolver;
+
+typedef struct {
+    int prune_regions;          /* region-size pruning */
+    int branch_constrained;     /* most-constrained-cell branching */
+} IqOptions;
+
+/* Called with the piece masks of every canonical solution. A nonzero
+   return stops the current iq_solve() call. */
+typedef int (*IqSolutionFn)(void *ctx, const uint64_t occ_piece[NUM_PIECES]);
+
+/* Called for every child of a node with fewer than split_depth pieces
+   placed. A nonzero return means the callee took the child over (e.g.
+   queued it for another thread) and the solver skips it. */
+typedef int (*IqSplitFn)(void *ctx, uint64_t occ, uint32_t used_mask,
+                         const uint64_t occ_piece[NUM_PIECES]);
+
+/* The process-wide tables, built on the first call. That call must not
+   race with other threads; call it once before starting them. */
+const IqTables *iq_tables(void);
+void            iq_tables_free(void);
+int             iq_place_count(const IqTables *t);
+uint64_t        iq_place_mask(const IqTables *t, int idx);
+int             iq_place_piece(const IqTables *t, int idx);
+
+IqSolver *iq_solver_create(const IqTables *t, const IqOptions *opt,
+                           IqSolutionFn fn, void *ctx);
+void      iq_solver_free(IqSolver *s);
+void      iq_solver_set_split(IqSolver *s, IqSplitFn fn, void *ctx,
+                              int split_depth);
+
+/* Searches every completion of the position; occ_piece holds the masks
+   of the pieces in used_mask (NULL for the empty board). Returns the
+   number of canonical solutions reported. */
+uint64_t  iq_solve(IqSolver *s, uint64_t occ, uint32_t used_mask,
+                   const uint64_t occ_piece[NUM_PIECES]);
+/* Same, starting from placements idx[0..depth-1] of place[]. */
+uint64_t  iq_solve_prefix(IqSolver *s, const uint16_t *idx, int depth);
+/* Pull interface to the same search: iq_solver_start() sets up a position
+   as iq_solve() would, and each iq_next_solution() call runs the search
+   up to its next canonical solution, copies its piece masks to occ_piece
+   (if not NULL) and returns 1, or returns 0 once the position is done.
+   The recursion is kept on an explicit stack in the solver, so a caller
+   can stop at any solution and go on later, or drop the search by simply
+   not calling again. Solutions come in iq_solve() order; the callback and
+   split callback are not used. */
+void      iq_solver_start(IqSolver *s, uint64_t occ, uint32_t used_mask,
+                          const uint64_t occ_piece[NUM_PIECES]);
+void      iq_solver_start_prefix(IqSolver *s, const uint16_t *idx, int depth);
+int       iq_next_solution(IqSolver *s, uint64_t occ_piece[NUM_PIECES]);
+
+/* Search nodes visited by all iq_solve() and iq_next_solution() calls on
+   this solver. */
+uint64_t  iq_solver_nodes(const IqSolver *s);
+
+#ifdef IQ_STATS
+/* Search statistics, compiled in with -DIQ_STATS (without it the search
+   keeps no counters at all). Depth is the number of pieces placed at a
+   node; a candidate is a placement tried at a node's branching cell. */
+typedef struct {
+    uint64_t nodes[NUM_PIECES + 1];         /* nodes visited, by depth */
+    uint64_t orphan[NUM_PIECES + 1];        /* cut by orphan_1x1() */
+    uint64_t region[NUM_PIECES + 1];        /* cut by region_infeasible() */
+    uint64_t skip_used[NUM_PIECES + 1];     /* candidates of a placed piece */
+    uint64_t skip_overlap[NUM_PIECES + 1];  /* candidates overlapping occ */
+    uint64_t branch_nodes[BOARD_CELLS];     /* nodes branching on a cell */
+    uint64_t branch_children[BOARD_CELLS];  /* children searched there */
+} IqStats;
+
+/* Adds the counters of s (all its iq_solve() calls) into *sum. */
+void iq_solver_stats(const IqSolver *s, IqStats *sum);
+void iq_stats_add(IqStats *sum, const IqStats *st);
+int  iq_stats_write(const char *path, const IqStats *st);
+#endif
+
+#endif
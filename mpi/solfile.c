@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "init.h"
+#include "solfile.h"
+
+size_t solfile_header_size(void)
+{
+    return sizeof(SolFileHeader) + 8u * place_cnt + ((place_cnt + 7u) & ~7u);
+}
+
+void solfile_header_image(void *buf, uint64_t count)
+{
+    SolFileHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, SOLFILE_MAGIC, 4);
+    h.version     = SOLFILE_VERSION;
+    h.board_w     = BOARD_W;
+    h.board_h     = BOARD_H;
+    h.pieces      = NUM_PIECES;
+    h.record_size = (NUM_PIECES + 1) * sizeof(uint16_t);
+    h.place_cnt   = place_cnt;
+    h.count       = count;
+    memcpy(h.piece_sym, piece_sym, NUM_PIECES);
+
+    uint8_t *p = buf;
+    memset(p, 0, solfile_header_size());
+    memcpy(p, &h, sizeof h);
+    p += sizeof h;
+    for (int i = 0; i < place_cnt; ++i, p += 8)
+        memcpy(p, &place[i].mask, 8);
+    for (int i = 0; i < place_cnt; ++i)
+        *p++ = place[i].piece;
+}
+
+int solfile_write_header(FILE *f, uint64_t count)
+{
+    size_t n = solfile_header_size();
+    void *buf = malloc(n);
+    if (!buf) return -1;
+    solfile_header_image(buf, count);
+    int rc = fwrite(buf, n, 1, f) == 1 ? 0 : -1;
+    free(buf);
+    return rc;
+}
+
+int solfile_set_count(FILE *f, uint64_t count)
+{
+    long pos = ftell(f);
+    if (fseek(f, offsetof(SolFileHeader, count), SEEK_SET) != 0) return -1;
+    if (fwrite(&count, sizeof count, 1, f) != 1) return -1;
+    return fseek(f, pos, SEEK_SET);
+}
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "worklist.h"
+
+#define ALL_PIECES ((1u<<NUM_PIECES)-1)
+
+static void push_prefix(PrefixList *pl, const Prefix *pf)
+{
+    if (pl->cnt == pl->cap) {
+        pl->cap = pl->cap ? 2*pl->cap : 1024;
+        pl->items = realloc(pl->items, pl->cap * sizeof *pl->items);
+    }
+    pl->items[pl->cnt++] = *pf;
+}
+
+static void enum_rec(PrefixList *pl, uint64_t occ, uint32_t used_mask,
+                     Prefix *cur, int depth)
+{
+    if (SHOULD_PRUNE(occ, used_mask)) return;
+
+    if (depth == pl->depth || used_mask == ALL_PIECES) {
+        push_prefix(pl, cur);
+        return;
+    }
+
+    int first = __builtin_ctzll(~occ & FULL_MASK);
+
+    const int *lst = placements_by_cell[first];
+    int  cnt = placements_by_cell_cnt[first];
+
+    for (int k=0;k<cnt;++k) {
+        int idx = lst[k];
+        int pid = idx_pid[idx];
+        if (used_mask & (1u<<pid)) continue;
+
+        uint64_t pmask = place[idx].mask;
+        if (pmask & occ) continue;
+
+        cur->idx[depth] = (uint16_t)idx;
+        enum_rec(pl, occ|pmask, used_mask|(1u<<pid), cur, depth+1);
+    }
+}
+
+void enum_prefixes(PrefixList *pl, int depth)
+{
+    Prefix cur;
+    memset(&cur, 0, sizeof cur);
+    pl->depth  = depth;
+    pl->shards = 1;
+    enum_rec(pl, 0ULL, 0, &cur, 0);
+}
+
+void prefix_state(const Prefix *pf, int depth, uint64_t *occ,
+                  uint32_t *used_mask, uint64_t occ_piece[NUM_PIECES])
+{
+    *occ = 0;
+    *used_mask = 0;
+    memset(occ_piece, 0, NUM_PIECES * sizeof(uint64_t));
+    for (int d=0; d<depth; ++d) {
+        int idx = pf->idx[d];
+        int pid = idx_pid[idx];
+        *occ |= place[idx].mask;
+        *used_mask |= 1u<<pid;
+        occ_piece[pid] = place[idx].mask;
+    }
+}
+
+static uint64_t next_rand(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* Knuth's estimator: follow random root-to-leaf paths and sum the product
+   of branching factors seen along each path. The mean over all probes is
+   an unbiased estimate of the number of dfs() calls below (occ, used_mask). */
+double estimate_subtree(uint64_t occ, uint32_t used_mask, int probes,
+                        uint64_t *rng)
+{
+    int cand[BOARD_CELLS * NUM_PIECES];
+    double total = 0;
+
+    for (int p=0; p<probes; ++p) {
+        uint64_t o = occ;
+        uint32_t u = used_mask;
+        double width = 1, nodes = 1;
+
+        while (!SHOULD_PRUNE(o, u) && u != ALL_PIECES) {
+            int first = BRANCH_CELL(o, u);
+            const int *lst = placements_by_cell[first];
+            int  n = 0;
+            for (int k=0;k<placements_by_cell_cnt[first];++k) {
+                int idx = lst[k];
+                if (u & (1u<<idx_pid[idx])) continue;
+                if (place[idx].mask & o) continue;
+                cand[n++] = idx;
+            }
+            if (!n) break;
+
+            width *= n;
+            nodes += width;
+
+            int idx = cand[next_rand(rng) % n];
+            o |= place[idx].mask;
+            u |= 1u<<idx_pid[idx];
+        }
+        total += nodes;
+    }
+    return total / probes;
+}
+
+static int by_est_desc(const void *a, const void *b)
+{
+    const Prefix *x = *(Prefix *const *)a, *y = *(Prefix *const *)b;
+    return (x->est < y->est) - (x->est > y->est);
+}
+
+/* Longest-processing-time-first bin packing of the estimated subtrees. */
+void partition_prefixes(PrefixList *pl, int shards, int probes)
+{
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (int i=0; i<pl->cnt; ++i) {
+        uint64_t occ, piece[NUM_PIECES];
+        uint32_t used;
+        prefix_state(&pl->items[i], pl->depth, &occ, &used, piece);
+        pl->items[i].est = estimate_subtree(occ, used, probes, &rng);
+    }
+
+    Prefix **order = malloc(pl->cnt * sizeof *order);
+    for (int i=0; i<pl->cnt; ++i) order[i] = &pl->items[i];
+    qsort(order, pl->cnt, sizeof *order, by_est_desc);
+
+    double *load = calloc(shards, sizeof *load);
+    for (int i=0; i<pl->cnt; ++i) {
+        int best = 0;
+        for (int s=1; s<shards; ++s)
+            if (load[s] < load[best]) best = s;
+        order[i]->shard = best;
+        load[best] += order[i]->est;
+    }
+    pl->shards = shards;
+
+    free(load);
+    free(order);
+}
+
+int write_worklist(const char *path, const PrefixList *pl)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); return -1; }
+
+    fprintf(f, "# IQ Fit work list: <shard> <estimated nodes> <placement indices>\n");
+    fprintf(f, "depth %d shards %d prefixes %d\n",
+            pl->depth, pl->shards, pl->cnt);
+    for (int s=0; s<pl->shards; ++s)
+        for (int i=0; i<pl->cnt; ++i) {
+            const Prefix *pf = &pl->items[i];
+            if (pf->shard != s) continue;
+            fprintf(f, "%d %.0f", s, pf->est);
+            for (int d=0; d<pl->depth; ++d)
+                fprintf(f, " %d", pf->idx[d]);
+            fputc('\n', f);
+        }
+
+    fclose(f);
+    return 0;
+}
+
+/* Loads the prefixes of one shard, or of every shard if shard < 0. */
+int read_worklist(const char *path, int shard, PrefixList *pl)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+
+    char line[256];
+    int have_header = 0;
+    int n;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        if (!have_header) {
+            if (sscanf(line, "depth %d shards %d", &pl->depth, &pl->shards) != 2 ||
+                pl->depth < 1 || pl->depth > MAX_PREFIX_DEPTH)
+                break;
+            have_header = 1;
+            continue;
+        }
+
+        Prefix pf;
+        memset(&pf, 0, sizeof pf);
+        char *p = line;
+        if (sscanf(p, "%d %lf%n", &pf.shard, &pf.est, &n) != 2) goto bad;
+        p += n;
+        for (int d=0; d<pl->depth; ++d) {
+            int idx;
+            if (sscanf(p, "%d%n", &idx, &n) != 1 || idx < 0 || idx >= place_cnt)
+                goto bad;
+            pf.idx[d] = (uint16_t)idx;
+            p += n;
+        }
+        if (shard < 0 || pf.shard == shard)
+            push_prefix(pl, &pf);
+    }
+
+    fclose(f);
+    if (!have_header) {
+        fprintf(stderr, "%s: missing work list header\n", path);
+        return -1;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "%s: malformed entry: %s", path, line);
+    fclose(f);
+    return -1;
+}
+
+void free_prefixes(PrefixList *pl)
+{
+    free(pl->items);
+    memset(pl, 0, sizeof *pl);
+}
@@ -0,0 +1,960 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <math.h>
+#include "init.h"
+#include "worklist.h"
+#include "writer.h"
+#include "dlx.h"
+#include "iqfit.h"
+
+#define ALL_PIECES ((1u<<NUM_PIECES)-1)
+
+static double now(void)
+{
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static uint64_t next_rand(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static uint64_t nodes, sols;
+
+/* Counting-only copy of dfs() parameterised on the prune test. */
+#define DEFINE_COUNT_DFS(name, PRUNE)                                   \
+static void name(uint64_t occ, uint32_t used_mask)                      \
+{                                                                       \
+    ++nodes;                                                            \
+    if (PRUNE(occ, used_mask)) return;                                  \
+    if (used_mask == ALL_PIECES) { ++sols; return; }                    \
+    int first = BRANCH_CELL(occ, used_mask);                            \
+    const int *lst = placements_by_cell[first];                         \
+    int  cnt = placements_by_cell_cnt[first];                           \
+    for (int k=0;k<cnt;++k) {                                           \
+        int idx = lst[k];                                               \
+        int pid = idx_pid[idx];                                         \
+        if (used_mask & (1u<<pid)) continue;                            \
+        uint64_t pmask = place[idx].mask;                               \
+        if (pmask & occ) continue;                                      \
+        name(occ|pmask, used_mask|(1u<<pid));                           \
+    }                                                                   \
+}
+
+#define ORPHAN_BITS(m, u)  orphan_1x1(m)
+#define ORPHAN_SCAN(m, u)  orphan_1x1_scan(m)
+
+DEFINE_COUNT_DFS(count_bits, ORPHAN_BITS)
+DEFINE_COUNT_DFS(count_scan, ORPHAN_SCAN)
+DEFINE_COUNT_DFS(count_dfs,  SHOULD_PRUNE)
+
+/* The same search over the anchored tables with a given candidate filter. */
+#define DEFINE_COUNT_ANCHOR(name, FIT)                                  \
+static void name(uint64_t occ, uint32_t used_mask)                      \
+{                                                                       \
+    ++nodes;                                                            \
+    if (SHOULD_PRUNE(occ, used_mask)) return;                           \
+    if (used_mask == ALL_PIECES) { ++sols; return; }                    \
+    int first = __builtin_ctzll(~occ & FULL_MASK);                      \
+    for (uint32_t todo = ~used_mask & ALL_PIECES; todo; todo &= todo-1) { \
+        int pid = __builtin_ctzll(todo);                                \
+        int g   = first*NUM_PIECES + pid;                               \
+        int end = anchor_start[g+1];                                    \
+        for (int k=anchor_start[g]; k<end; k+=FIT_LANES) {              \
+            unsigned fit = FIT(&anchor_mask[k], occ) & lane_mask(end-k); \
+            for (; fit; fit &= fit-1)                                   \
+                name(occ|anchor_mask[k + __builtin_ctzll(fit)],         \
+                     used_mask|(1u<<pid));                              \
+        }                                                               \
+    }                                                                   \
+}
+
+DEFINE_COUNT_ANCHOR(count_anchor_scalar, fit_lanes_scalar)
+DEFINE_COUNT_ANCHOR(count_anchor_simd,   fit_lanes)
+
+typedef void (*count_fn)(uint64_t, uint32_t);
+
+/* Searches every stride-th depth-3 subtree; returns the elapsed time. */
+static double count_subtrees(count_fn fn, int stride,
+                             uint64_t *n, uint64_t *s)
+{
+    /* same prefix list whatever pruning is being measured */
+    int saved = prune_regions;
+    PrefixList pl = {0};
+    prune_regions = 0;
+    enum_prefixes(&pl, 3);
+    prune_regions = saved;
+
+    nodes = sols = 0;
+    double t0 = now();
+    for (int i=0;i<pl.cnt;i+=stride) {
+        uint64_t occ, piece[NUM_PIECES];
+        uint32_t used;
+        prefix_state(&pl.items[i], pl.depth, &occ, &used, piece);
+        fn(occ, used);
+    }
+    double t = now() - t0;
+    free_prefixes(&pl);
+
+    *n = nodes;
+    *s = sols;
+    return t;
+}
+
+static void report(const char *name, uint64_t n, uint64_t s, double t)
+{
+    printf("  %-8s %12" PRIu64 " nodes %8" PRIu64 " solutions %8.2f s %8.2f Mnodes/s\n",
+           name, n, s, t, n / t / 1e6);
+}
+
+/* Board states reached by random descents, i.e. what dfs() sees. */
+static uint64_t *sample_states(int n)
+{
+    uint64_t *st = malloc(n * sizeof *st);
+    uint64_t rng = 0x2545F4914F6CDD1DULL;
+    int cand[BOARD_CELLS * NUM_PIECES];
+    int i = 0;
+
+    while (i < n) {
+        uint64_t occ = 0;
+        uint32_t used = 0;
+        while (i < n && used != ALL_PIECES) {
+            st[i++] = occ;
+            if (orphan_1x1_scan(occ)) break;
+            int first = __builtin_ctzll(~occ & FULL_MASK);
+            int c = 0;
+            for (int k=0;k<placements_by_cell_cnt[first];++k) {
+                int idx = placements_by_cell[first][k];
+                if (used & (1u<<idx_pid[idx])) continue;
+                if (place[idx].mask & occ) continue;
+                cand[c++] = idx;
+            }
+            if (!c) break;
+            int idx = cand[next_rand(&rng) % c];
+            occ  |= place[idx].mask;
+            used |= 1u<<idx_pid[idx];
+        }
+    }
+    return st;
+}
+
+static int bench_orphan(int states, int stride)
+{
+    uint64_t *st = sample_states(states);
+    int mismatch = 0;
+    for (int i=0;i<states;++i)
+        mismatch += orphan_1x1(st[i]) != orphan_1x1_scan(st[i]);
+
+    unsigned hits = 0;
+    double t0 = now();
+    for (int rep=0; rep<10; ++rep)
+        for (int i=0;i<states;++i) hits += orphan_1x1_scan(st[i]);
+    double t_scan = now() - t0;
+
+    t0 = now();
+    for (int rep=0; rep<10; ++rep)
+        for (int i=0;i<states;++i) hits += orphan_1x1(st[i]);
+    double t_bits = now() - t0;
+    free(st);
+
+    printf("orphan_1x1 on %d sampled states (%u prunes), %d mismatches\n",
+           states, hits / 20, mismatch);
+    printf("  %-8s %8.2f Mcalls/s\n", "scan", 10.0*states / t_scan / 1e6);
+    printf("  %-8s %8.2f Mcalls/s\n", "bitboard", 10.0*states / t_bits / 1e6);
+
+    uint64_t n[2], s[2];
+    double   t[2];
+    t[0] = count_subtrees(count_scan, stride, &n[0], &s[0]);
+    t[1] = count_subtrees(count_bits, stride, &n[1], &s[1]);
+
+    printf("dfs over every %d-th depth-3 subtree\n", stride);
+    report("scan", n[0], s[0], t[0]);
+    report("bitboard", n[1], s[1], t[1]);
+
+    return (mismatch || n[0] != n[1] || s[0] != s[1]) ? 1 : 0;
+}
+
+/* Search with a per-solution callback, for measuring output paths. */
+static void (*on_solution)(const uint64_t occ_piece[NUM_PIECES]);
+
+static void collect_dfs(uint64_t occ, uint32_t used_mask,
+                        uint64_t occ_piece[NUM_PIECES])
+{
+    if (SHOULD_PRUNE(occ, used_mask)) return;
+    if (used_mask == ALL_PIECES) { ++sols; on_solution(occ_piece); return; }
+
+    int first = __builtin_ctzll(~occ & FULL_MASK);
+    const int *lst = placements_by_cell[first];
+    int  cnt = placements_by_cell_cnt[first];
+    for (int k=0;k<cnt;++k) {
+        int idx = lst[k];
+        int pid = idx_pid[idx];
+        if (used_mask & (1u<<pid)) continue;
+        uint64_t pmask = place[idx].mask;
+        if (pmask & occ) continue;
+        occ_piece[pid] = pmask;
+        collect_dfs(occ|pmask, used_mask|(1u<<pid), occ_piece);
+        occ_piece[pid] = 0;
+    }
+}
+
+static FILE   *sync_fp;
+static Writer *async_w;
+static uint64_t sync_written;
+
+static void ignore_solution(const uint64_t occ_piece[NUM_PIECES])
+{
+    (void)occ_piece;
+}
+
+/* The synchronous stdio path of iq_serial's emit()/dump_solution(). */
+static void sync_dump(const char board[])
+{
+    ++sync_written;
+    fprintf(sync_fp,"Solution %" PRIu64 ":\n", sync_written);
+    for (int r = 0; r < BOARD_H; ++r) {
+        for (int c = 0; c < BOARD_W; ++c)
+            fputc(board[r*BOARD_W+c], sync_fp), fputc(' ', sync_fp);
+        fputc('\n', sync_fp);
+    }
+    fputs("==========\n", sync_fp);
+}
+
+static void sync_solution(const uint64_t occ_piece[NUM_PIECES])
+{
+    uint16_t id[NUM_PIECES];
+    char B[BOARD_CELLS];
+    int sym[4];
+    solution_ids(occ_piece, id);
+    int n = solution_variants_ids(id, sym);
+    for (int i = 0; i < n; ++i) {
+        solution_board(id, sym[i], B);
+        sync_dump(B);
+    }
+}
+
+static void async_solution(const uint64_t occ_piece[NUM_PIECES])
+{
+    writer_push(async_w, occ_piece);
+}
+
+static double run_collect(void (*fn)(const uint64_t *), int stride)
+{
+    PrefixList pl = {0};
+    enum_prefixes(&pl, 3);
+
+    on_solution = fn;
+    sols = 0;
+    double t0 = now();
+    for (int i=0;i<pl.cnt;i+=stride) {
+        uint64_t occ, piece[NUM_PIECES];
+        uint32_t used;
+        prefix_state(&pl.items[i], pl.depth, &occ, &used, piece);
+        collect_dfs(occ, used, piece);
+    }
+    free_prefixes(&pl);
+    return now() - t0;
+}
+
+static int bench_writer(int stride)
+{
+    const char *tmp = "bench_writer.tmp";
+
+    double t_none = run_collect(ignore_solution, stride);
+    uint64_t canon = sols;
+
+    sync_fp = fopen(tmp, "w");
+    if (!sync_fp) { perror(tmp); return 1; }
+    sync_written = 0;
+    double t0 = now();
+    run_collect(sync_solution, stride);
+    fclose(sync_fp);
+    double t_sync = now() - t0;
+
+    FILE *f = fopen(tmp, "w");
+    if (!f) { perror(tmp); return 1; }
+    WriterStats ws;
+    t0 = now();
+    async_w = writer_open(fileno(f), 0, 1);
+    double t_search = run_collect(async_solution, stride);
+    writer_close(async_w, &ws);
+    fclose(f);
+    double t_async = now() - t0;
+    remove(tmp);
+
+    printf("output of every %d-th depth-3 subtree: %" PRIu64 " canonical, "
+           "%" PRIu64 " boards\n", stride, canon, ws.solutions);
+    printf("  %-8s %8.2f s\n", "no I/O", t_none);
+    printf("  %-8s %8.2f s\n", "stdio", t_sync);
+    printf("  %-8s %8.2f s (search %.2f s, stalled %" PRIu64 " times / %.3f s, "
+           "%" PRIu64 " write() calls)\n",
+           "async", t_async, t_search, ws.stalls, ws.stall_sec, ws.writes);
+
+    return ws.solutions != sync_written;
+}
+
+static uint64_t *kept;
+static size_t    kept_n, kept_cap;
+
+static void keep_solution(const uint64_t occ_piece[NUM_PIECES])
+{
+    if (kept_n == kept_cap) {
+        kept_cap = kept_cap ? 2*kept_cap : 4096;
+        kept = realloc(kept, kept_cap * NUM_PIECES * sizeof *kept);
+    }
+    memcpy(kept + kept_n++ * NUM_PIECES, occ_piece, NUM_PIECES * sizeof *kept);
+}
+
+static int collect_solution(void *ctx, const uint64_t occ_piece[NUM_PIECES])
+{
+    (void)ctx;
+    keep_solution(occ_piece);
+    return 0;
+}
+
+static uint64_t board_hash(uint64_t h, const char B[BOARD_CELLS])
+{
+    for (int b = 0; b < BOARD_CELLS; ++b) h = (h ^ (uint8_t)B[b]) * 0x100000001b3ULL;
+    return h;
+}
+
+/* The previous emit(): mirror a char board and compare the copies. */
+static int expand_chars(const uint64_t occ_piece[NUM_PIECES],
+                        char out[4][BOARD_CELLS])
+{
+    char B[BOARD_CELLS], Bh[BOARD_CELLS], Bv[BOARD_CELLS], Br[BOARD_CELLS];
+    memset(B, '.', BOARD_CELLS);
+    for (int pid = 0; pid < NUM_PIECES; ++pid)
+        for (uint64_t m = occ_piece[pid]; m; m &= m-1)
+            B[__builtin_ctzll(m)] = piece_sym[pid];
+    for (int r = 0; r < BOARD_H; ++r)
+        for (int c = 0; c < BOARD_W; ++c) {
+            Bh[r*BOARD_W + c] = B[r*BOARD_W + BOARD_W-1-c];
+            Bv[r*BOARD_W + c] = B[(BOARD_H-1-r)*BOARD_W + c];
+            Br[r*BOARD_W + c] = B[(BOARD_H-1-r)*BOARD_W + BOARD_W-1-c];
+        }
+    int n = 0;
+    memcpy(out[n++], B, BOARD_CELLS);
+    if (memcmp(B, Bh, BOARD_CELLS)) memcpy(out[n++], Bh, BOARD_CELLS);
+    if (memcmp(B, Bv, BOARD_CELLS) && memcmp(Bh, Bv, BOARD_CELLS))
+        memcpy(out[n++], Bv, BOARD_CELLS);
+    if (memcmp(B, Br, BOARD_CELLS) && memcmp(Bh, Br, BOARD_CELLS) &&
+        memcmp(Bv, Br, BOARD_CELLS))
+        memcpy(out[n++], Br, BOARD_CELLS);
+    return n;
+}
+
+static int expand_ids(const uint64_t occ_piece[NUM_PIECES],
+                      char out[4][BOARD_CELLS])
+{
+    uint16_t id[NUM_PIECES];
+    int sym[4];
+    solution_ids(occ_piece, id);
+    int n = solution_variants_ids(id, sym);
+    for (int i = 0; i < n; ++i) solution_board(id, sym[i], out[i]);
+    return n;
+}
+
+static int count_ids(const uint64_t occ_piece[NUM_PIECES],
+                     char out[4][BOARD_CELLS])
+{
+    uint16_t id[NUM_PIECES];
+    int sym[4];
+    solution_ids(occ_piece, id);
+    int n = solution_variants_ids(id, sym);
+    out[0][0] = (char)id[0];
+    return n;
+}
+
+/* Cost of the symmetry stage per canonical solution, without I/O, next to
+   the search that found the solutions; each stage is timed over SYM_REPS
+   passes. */
+#define SYM_REPS 20
+
+static int bench_symmetry(int stride)
+{
+    kept_n = 0;
+    double t_search = run_collect(keep_solution, stride);
+
+    static const struct {
+        const char *name;
+        int (*fn)(const uint64_t *, char [4][BOARD_CELLS]);
+    } stage[] = {
+        { "char boards", expand_chars },
+        { "placement ids", expand_ids },
+        { "ids, no boards", count_ids },
+    };
+    uint64_t hash[2] = { 0xcbf29ce484222325ULL, 0xcbf29ce484222325ULL };
+    uint64_t boards[3];
+    char out[4][BOARD_CELLS];
+    unsigned sink = 0;
+
+    printf("symmetry stage over every %d-th depth-3 subtree: %zu canonical "
+           "solutions, search %.2f s\n", stride, kept_n, t_search);
+    for (int v = 0; v < 3; ++v) {
+        boards[v] = 0;
+        double t0 = now();
+        for (int rep = 0; rep < SYM_REPS; ++rep)
+            for (size_t i = 0; i < kept_n; ++i) {
+                int n = stage[v].fn(kept + i*NUM_PIECES, out);
+                boards[v] += n;
+                sink += (unsigned char)out[n-1][i % BOARD_CELLS];
+            }
+        double t = (now() - t0) / SYM_REPS;
+        boards[v] /= SYM_REPS;
+        printf("  %-15s %9" PRIu64 " boards %8.3f s %7.1f ns/solution "
+               "%6.3f%% of search\n", stage[v].name, boards[v], t,
+               kept_n ? t * 1e9 / kept_n : 0.0, 100.0 * t / t_search);
+    }
+    for (int v = 0; v < 2; ++v)
+        for (size_t i = 0; i < kept_n; ++i) {
+            int n = stage[v].fn(kept + i*NUM_PIECES, out);
+            for (int k = 0; k < n; ++k) hash[v] = board_hash(hash[v], out[k]);
+        }
+    free(kept);
+    kept = NULL;
+    kept_cap = 0;
+
+    int bad = hash[0] != hash[1] || boards[0] != boards[1] || boards[1] != boards[2];
+    if (bad) printf("  the stages disagree\n");
+    return bad + (sink == 1);   /* keeps the timed loops from being dropped */
+}
+
+static int bench_regions(int stride)
+{
+    uint64_t n[2], s[2];
+    double   t[2];
+    for (int v=0; v<2; ++v) {
+        prune_regions = v;
+        t[v] = count_subtrees(count_dfs, stride, &n[v], &s[v]);
+    }
+    prune_regions = 0;
+
+    printf("dfs over every %d-th depth-3 subtree\n", stride);
+    report("orphan", n[0], s[0], t[0]);
+    report("regions", n[1], s[1], t[1]);
+
+    return s[0] != s[1] ? 1 : 0;
+}
+
+static int bench_branch(int stride)
+{
+    uint64_t n[2], s[2];
+    double   t[2];
+    for (int v=0; v<2; ++v) {
+        branch_constrained = v;
+        t[v] = count_subtrees(count_dfs, stride, &n[v], &s[v]);
+    }
+    branch_constrained = 0;
+
+    printf("dfs over every %d-th depth-3 subtree\n", stride);
+    report("lowest", n[0], s[0], t[0]);
+    report("mrv", n[1], s[1], t[1]);
+
+    return s[0] != s[1] ? 1 : 0;
+}
+
+static int bench_anchor(int stride)
+{
+    uint64_t n[3], s[3];
+    double   t[3];
+    t[0] = count_subtrees(count_bits, stride, &n[0], &s[0]);
+    t[1] = count_subtrees(count_anchor_scalar, stride, &n[1], &s[1]);
+    t[2] = count_subtrees(count_anchor_simd, stride, &n[2], &s[2]);
+
+    printf("dfs over every %d-th depth-3 subtree, %d-lane %s filter\n", stride,
+           FIT_LANES,
+#if defined(__AVX512F__)
+           "AVX-512"
+#elif defined(__AVX2__)
+           "AVX2"
+#else
+           "scalar"
+#endif
+           );
+    report("by cell", n[0], s[0], t[0]);
+    report("scalar", n[1], s[1], t[1]);
+    report("simd", n[2], s[2], t[2]);
+
+    return (n[0] != n[1] || n[0] != n[2] || s[0] != s[1] || s[0] != s[2]) ? 1 : 0;
+}
+
+/* Both engines on the same subproblems, timed one subtree at a time. */
+static int bench_dlx(int stride)
+{
+    PrefixList pl = {0};
+    enum_prefixes(&pl, 3);
+    Dlx *d = dlx_create();
+    if (!d) { fprintf(stderr, "Cannot build the DLX matrix\n"); return 1; }
+
+    uint64_t n_dfs = 0, s_dfs = 0, s_dlx = 0;
+    double t_dfs = 0, t_dlx = 0;
+    int subtrees = 0, dlx_wins = 0, mismatch = 0;
+    for (int i=0;i<pl.cnt;i+=stride) {
+        uint64_t occ, piece[NUM_PIECES];
+        uint32_t used;
+        prefix_state(&pl.items[i], pl.depth, &occ, &used, piece);
+
+        nodes = sols = 0;
+        double t0 = now();
+        count_dfs(occ, used);
+        double t1 = now();
+        uint64_t found = dlx_solve(d, pl.items[i].idx, pl.depth, NULL, NULL);
+        double t2 = now();
+
+        n_dfs += nodes;
+        s_dfs += sols;
+        s_dlx += found;
+        t_dfs += t1 - t0;
+        t_dlx += t2 - t1;
+        dlx_wins += t2 - t1 < t1 - t0;
+        mismatch += found != sols;
+        ++subtrees;
+    }
+
+    printf("every %d-th depth-3 subtree (%d subtrees), %d count mismatches\n",
+           stride, subtrees, mismatch);
+    report("dfs", n_dfs, s_dfs, t_dfs);
+    report("dlx", dlx_nodes(d), s_dlx, t_dlx);
+    printf("  dlx faster on %d of %d subtrees\n", dlx_wins, subtrees);
+
+    dlx_free(d);
+    free_prefixes(&pl);
+    return mismatch ? 1 : 0;
+}
+
+typedef struct {
+    pthread_t         tid;
+    const PrefixList *pl;
+    int               stride;
+    uint64_t          nodes, sols;
+} Instance;
+
+static void *run_instance(void *arg)
+{
+    Instance *in = arg;
+    IqSolver *s = iq_solver_create(iq_tables(), NULL, NULL, NULL);
+    for (int i=0;i<in->pl->cnt;i+=in->stride)
+        in->sols += iq_solve_prefix(s, in->pl->items[i].idx, in->pl->depth);
+    in->nodes = iq_solver_nodes(s);
+    iq_solver_free(s);
+    return NULL;
+}
+
+/* n independent solvers, one per thread, each searching the same
+   subtrees. Without shared mutable state the aggregate rate should grow
+   with min(n, cores) and every instance should count the same. */
+static int bench_instances(int stride)
+{
+    PrefixList pl = {0};
+    enum_prefixes(&pl, 3);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) cores = 1;
+
+    printf("every %d-th depth-3 subtree per instance, %ld cores\n", stride, cores);
+    double base = 0;
+    int mismatch = 0;
+    for (int n = 1; n <= 2*cores && n <= 64; n *= 2) {
+        Instance *in = calloc(n, sizeof *in);
+        double t0 = now();
+        for (int i = 0; i < n; ++i) {
+            in[i].pl = &pl;
+            in[i].stride = stride;
+            pthread_create(&in[i].tid, NULL, run_instance, &in[i]);
+        }
+        for (int i = 0; i < n; ++i) pthread_join(in[i].tid, NULL);
+        double t = now() - t0;
+
+        uint64_t total = 0;
+        for (int i = 0; i < n; ++i) {
+            total += in[i].nodes;
+            mismatch += in[i].nodes != in[0].nodes || in[i].sols != in[0].sols;
+        }
+        double rate = total / t / 1e6;
+        if (n == 1) base = rate;
+        printf("  %2d instances %12" PRIu64 " nodes %8.2f s %8.2f Mnodes/s"
+               "  %5.1f%% of %ldx one instance\n",
+               n, total, t, rate, 100.0 * rate / (base * (n < cores ? n : cores)),
+               n < cores ? (long)n : cores);
+        free(in);
+    }
+    if (mismatch) printf("  %d instances disagree\n", mismatch);
+
+    free_prefixes(&pl);
+    return mismatch ? 1 : 0;
+}
+
+/* Order-sensitive hash of the solutions, to check that two searches
+   report the same ones in the same order. */
+static int hash_solution(void *ctx, const uint64_t occ_piece[NUM_PIECES])
+{
+    uint64_t *h = ctx;
+    for (int p = 0; p < NUM_PIECES; ++p) *h = (*h ^ occ_piece[p]) * 0x100000001b3ULL;
+    return 0;
+}
+
+/* iq_solve() against pulling the same solutions one at a time with
+   iq_next_solution(), with both branching rules. */
+static int bench_iter(int stride)
+{
+    PrefixList pl = {0};
+    enum_prefixes(&pl, 3);
+    printf("every %d-th depth-3 subtree\n", stride);
+
+    int bad = 0;
+    for (int c = 0; c < 2; ++c) {
+        IqOptions opt = { .branch_constrained = c };
+        uint64_t h[2] = { 0xcbf29ce484222325ULL, 0xcbf29ce484222325ULL };
+        uint64_t n[2], sol[2] = {0, 0};
+        double t[2];
+
+        IqSolver *s = iq_solver_create(iq_tables(), &opt, hash_solution, &h[0]);
+        double t0 = now();
+        for (int i=0;i<pl.cnt;i+=stride)
+            sol[0] += iq_solve_prefix(s, pl.items[i].idx, pl.depth);
+        t[0] = now() - t0;
+        n[0] = iq_solver_nodes(s);
+        iq_solver_free(s);
+
+        uint64_t piece[NUM_PIECES];
+        s = iq_solver_create(iq_tables(), &opt, NULL, NULL);
+        t0 = now();
+        for (int i=0;i<pl.cnt;i+=stride) {
+            iq_solver_start_prefix(s, pl.items[i].idx, pl.depth);
+            while (iq_next_solution(s, piece)) {
+                hash_solution(&h[1], piece);
+                ++sol[1];
+            }
+        }
+        t[1] = now() - t0;
+        n[1] = iq_solver_nodes(s);
+        iq_solver_free(s);
+
+        printf("%s branching:\n", c ? "constrained" : "lowest-cell");
+        report("recurse", n[0], sol[0], t[0]);
+        report("iterate", n[1], sol[1], t[1]);
+        printf("  iterative at %.1f%% of the recursive node rate\n",
+               100.0 * (n[1] / t[1]) / (n[0] / t[0]));
+        if (n[0] != n[1] || sol[0] != sol[1] || h[0] != h[1]) {
+            printf("  MISMATCH: nodes, solutions or their order differ\n");
+            bad = 1;
+        }
+    }
+    free_prefixes(&pl);
+    return bad;
+}
+
+/* ---------- regression suite ---------- */
+
+/* Fixed subproblems: the k1-th placement covering the first cell, then
+   the k2-th placement covering the next empty cell, both indices into
+   placements_by_cell[]. Each takes 0.05-0.5 s; nodes and sols are what
+   the search must report, so a change that alters the search fails the
+   suite instead of just timing differently. */
+static const struct {
+    const char *name;
+    int         k1, k2;
+    int         prune_regions, branch_constrained;
+    uint64_t    nodes, sols;
+} suite[] = {
+    { "p0-42",             0, 42, 0, 0,  8992973, 1635 },
+    { "p1-60",             1, 60, 0, 0,  7116127, 2897 },
+    { "p3-66",             3, 66, 0, 0, 10725143, 2432 },
+    { "p7-93",             7, 93, 0, 0,  8791977, 2781 },
+    { "p7-75-dead",        7, 75, 0, 0,  2015395,    0 },
+    { "p9-36-dead",        9, 36, 0, 0,  6365853,    0 },
+    { "p3-66-regions",     3, 66, 1, 0,  6011452, 2432 },
+    { "p3-66-constrained", 3, 66, 0, 1,   251343, 2432 },
+    { "p7-93-both",        7, 93, 1, 1,   315232, 2781 },
+};
+#define SUITE_N     (int)(sizeof suite / sizeof *suite)
+#define SUITE_RUNS  5
+#define SUITE_OUT   8           /* passes over the solutions per output run */
+#define REGRESS_PCT 10.0        /* slower than the baseline by this much fails */
+
+typedef struct {
+    char   workload[32], metric[32], unit[16];
+    int    runs;
+    double mean, sd, min, max;
+} Row;
+
+static Row   *rows;
+static int    rows_n;
+
+static void add_row(const char *workload, const char *metric,
+                    const char *unit, const double *v, int runs)
+{
+    rows = realloc(rows, (rows_n + 1) * sizeof *rows);
+    Row *r = &rows[rows_n++];
+    memset(r, 0, sizeof *r);
+    snprintf(r->workload, sizeof r->workload, "%s", workload);
+    snprintf(r->metric, sizeof r->metric, "%s", metric);
+    snprintf(r->unit, sizeof r->unit, "%s", unit);
+    r->runs = runs;
+    r->min = r->max = v[0];
+    for (int i = 0; i < runs; ++i) {
+        r->mean += v[i] / runs;
+        if (v[i] < r->min) r->min = v[i];
+        if (v[i] > r->max) r->max = v[i];
+    }
+    for (int i = 0; i < runs; ++i)
+        r->sd += (v[i] - r->mean) * (v[i] - r->mean);
+    r->sd = runs > 1 ? sqrt(r->sd / (runs - 1)) : 0.0;
+}
+
+/* Rates are better when higher, times (ms) when lower; the best run is
+   compared, which is the least noisy figure on a shared machine. */
+static int rate_unit(const char *unit)
+{
+    size_t n = strlen(unit);
+    return n > 2 && !strcmp(unit + n - 2, "/s");
+}
+
+static int compare_baseline(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+
+    char line[512];
+    int regressions = 0, matched = 0;
+    while (fgets(line, sizeof line, f)) {
+        Row b;
+        if (sscanf(line, "%31[^,],%31[^,],%15[^,],%d,%lf,%lf,%lf,%lf",
+                   b.workload, b.metric, b.unit, &b.runs,
+                   &b.mean, &b.sd, &b.min, &b.max) != 8)
+            continue;
+        for (int i = 0; i < rows_n; ++i) {
+            const Row *r = &rows[i];
+            if (strcmp(r->workload, b.workload) || strcmp(r->metric, b.metric))
+                continue;
+            ++matched;
+            int rate = rate_unit(r->unit);
+            double now_best  = rate ? r->max : r->min;
+            double base_best = rate ? b.max  : b.min;
+            double loss = 100.0 * (rate ? base_best - now_best : now_best - base_best)
+                        / base_best;
+            if (loss > REGRESS_PCT) {
+                fprintf(stderr, "REGRESSION %s %s: %.4g %s, baseline %.4g (%.1f%% worse)\n",
+                        r->workload, r->metric, now_best, r->unit, base_best, loss);
+                ++regressions;
+            }
+        }
+    }
+    fclose(f);
+    fprintf(stderr, "%d metrics compared with %s, %d regressions\n",
+            matched, path, regressions);
+    return regressions;
+}
+
+static double out_bytes;
+
+static int suite_output(const char *name, int binary, int async, int runs)
+{
+    const char *tmp = "bench_suite.tmp";
+    double *mbs = malloc(runs * sizeof *mbs), *bps = malloc(runs * sizeof *bps);
+    uint64_t boards = 0;
+
+    for (int r = 0; r < runs; ++r) {
+        FILE *f = fopen(tmp, "w");
+        if (!f) { perror(tmp); return 1; }
+        double t0 = now();
+        if (async) {
+            WriterStats ws;
+            Writer *w = writer_open(fileno(f), binary, 1);
+            for (int p = 0; p < SUITE_OUT; ++p)
+                for (size_t i = 0; i < kept_n; ++i)
+                    writer_push(w, kept + i*NUM_PIECES);
+            writer_close(w, &ws);
+            out_bytes = ws.bytes;
+            boards = ws.solutions;
+        } else {
+            sync_fp = f;
+            sync_written = 0;
+            for (int p = 0; p < SUITE_OUT; ++p)
+                for (size_t i = 0; i < kept_n; ++i)
+                    sync_solution(kept + i*NUM_PIECES);
+            fflush(f);
+            out_bytes = ftell(f);
+            boards = sync_written;
+        }
+        fclose(f);
+        double t = now() - t0;
+        mbs[r] = out_bytes / t / 1e6;
+        bps[r] = boards / t / 1e6;
+    }
+    remove(tmp);
+    add_row(name, "throughput", "MB/s", mbs, runs);
+    add_row(name, "boards", "Mboards/s", bps, runs);
+    free(mbs);
+    free(bps);
+    return 0;
+}
+
+/* Takes every child over and searches it at once on a second solver, as
+   a worker thread of iq_serial -t would, only in order. */
+static int take_child(void *ctx, uint64_t occ, uint32_t used_mask,
+                      const uint64_t occ_piece[NUM_PIECES])
+{
+    iq_solve(ctx, occ, used_mask, occ_piece);
+    return 1;
+}
+
+/* Solves the prefix once plainly and once handing the children of depth 2
+   and 3 to another solver. The nodes, the order of the solutions and,
+   built with -DIQ_STATS, every counter must not depend on the split (that
+   is, on the thread count). */
+static int split_check(const char *name, const IqOptions *opt,
+                       const uint16_t *idx)
+{
+    uint64_t h[2] = { 0xcbf29ce484222325ULL, 0xcbf29ce484222325ULL };
+    IqSolver *plain  = iq_solver_create(iq_tables(), opt, hash_solution, &h[0]);
+    IqSolver *split  = iq_solver_create(iq_tables(), opt, hash_solution, &h[1]);
+    IqSolver *helper = iq_solver_create(iq_tables(), opt, hash_solution, &h[1]);
+    iq_solver_set_split(split, take_child, helper, 4);
+    iq_solve_prefix(plain, idx, 2);
+    iq_solve_prefix(split, idx, 2);
+
+    int bad = iq_solver_nodes(plain) !=
+              iq_solver_nodes(split) + iq_solver_nodes(helper) || h[0] != h[1];
+#ifdef IQ_STATS
+    IqStats a, b;
+    memset(&a, 0, sizeof a);
+    memset(&b, 0, sizeof b);
+    iq_solver_stats(plain, &a);
+    iq_solver_stats(split, &b);
+    iq_solver_stats(helper, &b);
+    bad |= memcmp(&a, &b, sizeof a) != 0;
+#endif
+    if (bad) fprintf(stderr, "MISMATCH %s: the split search differs\n", name);
+    iq_solver_free(plain);
+    iq_solver_free(split);
+    iq_solver_free(helper);
+    return bad;
+}
+
+/* The fixed workloads, run `runs` times each: search rates per subproblem,
+   table start-up, and output throughput over the solutions they found.
+   Writes CSV to stdout and, with a baseline CSV from an earlier run,
+   fails when a best run is REGRESS_PCT worse than the baseline's. */
+static int bench_suite(int runs, const char *baseline)
+{
+    double *a = malloc(runs * sizeof *a), *b = malloc(runs * sizeof *b);
+    int bad = 0;
+    kept_n = 0;
+
+    for (int w = 0; w < SUITE_N; ++w) {
+        int c0 = __builtin_ctzll(FULL_MASK);
+        uint16_t idx[2];
+        idx[0] = (uint16_t)placements_by_cell[c0][suite[w].k1];
+        int c1 = __builtin_ctzll(~place[idx[0]].mask & FULL_MASK);
+        idx[1] = (uint16_t)placements_by_cell[c1][suite[w].k2];
+
+        IqOptions opt = { suite[w].prune_regions, suite[w].branch_constrained };
+        int keep = !opt.prune_regions && !opt.branch_constrained;
+        for (int r = 0; r < runs; ++r) {
+            IqSolver *s = iq_solver_create(iq_tables(), &opt,
+                                           keep && r == 0 ? collect_solution : NULL,
+                                           NULL);
+            double t0 = now();
+            uint64_t found = iq_solve_prefix(s, idx, 2);
+            double t = now() - t0;
+            uint64_t n = iq_solver_nodes(s);
+            iq_solver_free(s);
+            if (n != suite[w].nodes || found != suite[w].sols) {
+                fprintf(stderr, "MISMATCH %s: %" PRIu64 " nodes, %" PRIu64
+                        " solutions, expected %" PRIu64 ", %" PRIu64 "\n",
+                        suite[w].name, n, found, suite[w].nodes, suite[w].sols);
+                bad = 1;
+            }
+            a[r] = n / t / 1e6;
+            b[r] = found / t;
+        }
+        bad |= split_check(suite[w].name, &opt, idx);
+        add_row(suite[w].name, "nodes", "Mnodes/s", a, runs);
+        if (suite[w].sols) add_row(suite[w].name, "solutions", "sol/s", b, runs);
+        fprintf(stderr, "%-18s %9.2f Mnodes/s\n", suite[w].name, rows[rows_n-1 - !!suite[w].sols].mean);
+    }
+
+    /* init_all() and build_tables() as a process start runs them */
+    for (int r = 0; r < runs; ++r) {
+        iq_tables_free();
+        double t0 = now();
+        iq_tables();
+        a[r] = (now() - t0) * 1e3;
+    }
+    add_row("startup", "tables", "ms", a, runs);
+
+    fprintf(stderr, "output: %zu canonical solutions, %d passes\n", kept_n, SUITE_OUT);
+    bad |= suite_output("output-text-stdio",  0, 0, runs);
+    bad |= suite_output("output-text-async",  0, 1, runs);
+    bad |= suite_output("output-binary-async", 1, 1, runs);
+
+    printf("workload,metric,unit,runs,mean,stddev,min,max,cv_pct\n");
+    for (int i = 0; i < rows_n; ++i) {
+        const Row *r = &rows[i];
+        printf("%s,%s,%s,%d,%.6g,%.4g,%.6g,%.6g,%.2f\n",
+               r->workload, r->metric, r->unit, r->runs, r->mean, r->sd,
+               r->min, r->max, r->mean ? 100.0 * r->sd / r->mean : 0.0);
+    }
+
+    if (baseline && compare_baseline(baseline) != 0) bad = 1;
+
+    free(a);
+    free(b);
+    free(rows);
+    free(kept);
+    kept = NULL;
+    kept_cap = 0;
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(stdout,NULL,_IONBF,0);
+
+    const char *what = argc > 1 ? argv[1] : "orphan";
+
+    iq_tables();
+
+    if (!strcmp(what, "suite")) {
+        int runs = argc > 2 ? atoi(argv[2]) : SUITE_RUNS;
+        return bench_suite(runs < 1 ? 1 : runs, argc > 3 ? argv[3] : NULL);
+    }
+
+    int stride = argc > 2 ? atoi(argv[2]) : 500;
+    if (stride < 1) stride = 1;
+
+    if (!strcmp(what, "orphan"))
+        return bench_orphan(1000000, stride);
+    if (!strcmp(what, "regions"))
+        return bench_regions(stride);
+    if (!strcmp(what, "writer"))
+        return bench_writer(stride);
+    if (!strcmp(what, "anchor"))
+        return bench_anchor(stride);
+    if (!strcmp(what, "branch"))
+        return bench_branch(stride);
+    if (!strcmp(what, "dlx"))
+        return bench_dlx(stride);
+    if (!strcmp(what, "instances"))
+        return bench_instances(stride);
+    if (!strcmp(what, "symmetry"))
+        return bench_symmetry(stride);
+    if (!strcmp(what, "iter"))
+        return bench_iter(stride);
+
+    fprintf(stderr, "Usage: %s [orphan|anchor|regions|branch|writer|dlx|instances|symmetry|iter [<stride>]]\n"
+                    "       %s suite [<runs> [<baseline.csv>]]\n", argv[0], argv[0]);
+    return 1;
+}
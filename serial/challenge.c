@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "challenge.h"
+
+static int piece_of(char ch)
+{
+    for (int pid = 0; pid < NUM_PIECES; ++pid)
+        if (piece_sym[pid] == ch) return pid;
+    return -1;
+}
+
+static void push_challenge(ChallengeList *cl, const Challenge *c)
+{
+    if (cl->cnt == cl->cap) {
+        cl->cap = cl->cap ? 2*cl->cap : 256;
+        cl->items = realloc(cl->items, cl->cap * sizeof *cl->items);
+    }
+    cl->items[cl->cnt++] = *c;
+}
+
+/* Cells of a board row with the separating blanks removed; 0 when the line
+   holds anything but piece letters and '.'. */
+static int row_cells(const char *line, char *cells, int max)
+{
+    int n = 0;
+    for (const char *p = line; *p; ++p) {
+        if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') continue;
+        if (*p != '.' && piece_of(*p) < 0) return 0;
+        if (n == max) return max + 1;
+        cells[n++] = *p;
+    }
+    return n;
+}
+
+static int finish_board(const char *path, int lineno, const char *board,
+                        ChallengeList *cl)
+{
+    Challenge c;
+    memset(&c, 0, sizeof c);
+    for (int b = 0; b < BOARD_CELLS; ++b) {
+        if (board[b] == '.') continue;
+        int pid = piece_of(board[b]);
+        c.occ_piece[pid] |= 1ULL << b;
+        c.used_mask |= 1u << pid;
+    }
+    for (int pid = 0; pid < NUM_PIECES; ++pid)
+        if ((c.used_mask & (1u<<pid)) &&
+            __builtin_popcountll(c.occ_piece[pid]) != piece_size[pid]) {
+            fprintf(stderr, "%s:%d: piece %c covers %d cells, not %d\n",
+                    path, lineno, piece_sym[pid],
+                    __builtin_popcountll(c.occ_piece[pid]), piece_size[pid]);
+            return -1;
+        }
+    push_challenge(cl, &c);
+    return 0;
+}
+
+int read_challenges(const char *path, ChallengeList *cl)
+{
+    FILE *f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!f) { perror(path); return -1; }
+
+    char line[256];
+    char board[BOARD_CELLS];
+    int rows = 0, lineno = 0, rc = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        ++lineno;
+        int n = row_cells(line, board + rows*BOARD_W, BOARD_W);
+        if (n == 0) {
+            if (rows) {
+                fprintf(stderr, "%s:%d: board has %d rows, not %d\n",
+                        path, lineno, rows, BOARD_H);
+                rc = -1;
+                break;
+            }
+            continue;
+        }
+        if (n != BOARD_W) {
+            fprintf(stderr, "%s:%d: row has %d cells, not %d\n",
+                    path, lineno, n, BOARD_W);
+            rc = -1;
+            break;
+        }
+        if (++rows == BOARD_H) {
+            rows = 0;
+            if ((rc = finish_board(path, lineno, board, cl)) != 0) break;
+        }
+    }
+    if (!rc && rows) {
+        fprintf(stderr, "%s: last board has %d rows, not %d\n",
+                path, rows, BOARD_H);
+        rc = -1;
+    }
+
+    if (f != stdin) fclose(f);
+    return rc;
+}
+
+void free_challenges(ChallengeList *cl)
+{
+    free(cl->items);
+    memset(cl, 0, sizeof *cl);
+}
+
+int challenge_state(const Challenge *c, int s, uint64_t *occ,
+                    uint32_t *used_mask, uint64_t occ_piece[NUM_PIECES])
+{
+    *occ = 0;
+    *used_mask = c->used_mask;
+    for (int pid = 0; pid < NUM_PIECES; ++pid) {
+        occ_piece[pid] = mask_transform(c->occ_piece[pid], s);
+        if (occ_piece[pid] && place_index(occ_piece[pid]) < 0) return 0;
+        *occ |= occ_piece[pid];
+    }
+    return 1;
+}
+
+/* The symmetries form a Klein group whose product is the XOR of their
+   codes, so symmetries t < s reach the same board exactly when t^s fixes
+   the solution. */
+int challenge_accept(const uint64_t occ_piece[NUM_PIECES], int s)
+{
+    if (!s) return 1;
+    int st = solution_stabiliser(occ_piece);
+    for (int t = 0; t < s; ++t)
+        if (st & (1 << ((t^s) - 1))) return 0;
+    return 1;
+}
+
+void challenge_board(const uint64_t occ_piece[NUM_PIECES], int s,
+                     char board[BOARD_CELLS])
+{
+    memset(board, '.', BOARD_CELLS);
+    for (int pid = 0; pid < NUM_PIECES; ++pid)
+        for (uint64_t m = mask_transform(occ_piece[pid], s); m; m &= m-1)
+            board[__builtin_ctzll(m)] = piece_sym[pid];
+}
@@ -0,0 +1,41 @@
+#ifndef CHALLENGE_H
+#define CHALLENGE_H
+
+#include <stdint.h>
+#include "init.h"
+
+/* A challenge is a board with some pieces already placed, written as the
+   BOARD_H rows of a solutions.txt board with '.' for the empty cells. The
+   search only enumerates canonical solutions, so a challenge is solved
+   once per board symmetry s from its image under s, and each solution
+   found is mapped back through s. */
+
+typedef struct {
+    uint64_t occ_piece[NUM_PIECES];
+    uint32_t used_mask;
+} Challenge;
+
+typedef struct {
+    Challenge *items;
+    int        cnt, cap;
+} ChallengeList;
+
+/* Reads every board of path ("-" for stdin). Lines that are not board rows
+   ("Solution 1:", "==========", comments) separate boards. */
+int  read_challenges(const char *path, ChallengeList *cl);
+void free_challenges(ChallengeList *cl);
+
+/* Start position of the search for symmetry s. Returns 0 when a placed
+   piece maps outside place[], i.e. no canonical solution extends it. */
+int  challenge_state(const Challenge *c, int s, uint64_t *occ,
+                     uint32_t *used_mask, uint64_t occ_piece[NUM_PIECES]);
+
+/* 1 unless the board of canonical solution occ_piece under s is also
+   reached from a smaller symmetry (the solution is symmetric). */
+int  challenge_accept(const uint64_t occ_piece[NUM_PIECES], int s);
+
+/* The board of canonical solution occ_piece under s, one char per cell. */
+void challenge_board(const uint64_t occ_piece[NUM_PIECES], int s,
+                     char board[BOARD_CELLS]);
+
+#endif
@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "checkpoint.h"
+
+#ifdef _WIN32
+  #include <io.h>
+  #define fsync     _commit
+  #define fileno    _fileno
+  #define fseeko    _fseeki64
+  #define ftello    _ftelli64
+  #define ftruncate _chsize_s
+#else
+  #include <unistd.h>
+#endif
+
+#define CKPT_MAGIC   "iqfit-checkpoint 1"
+#define HEX_PER_LINE 64
+
+/* FNV-1a over the placements of every prefix. */
+static uint64_t list_hash(const PrefixList *pl)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < pl->cnt; ++i)
+        for (int d = 0; d < pl->depth; ++d) {
+            h ^= pl->items[i].idx[d];
+            h *= 0x100000001b3ULL;
+        }
+    return h;
+}
+
+void ckpt_init(Checkpoint *c, const PrefixList *pl, uint32_t params)
+{
+    memset(c, 0, sizeof *c);
+    c->params = params;
+    c->depth  = pl->depth;
+    c->cnt    = pl->cnt;
+    c->hash   = list_hash(pl);
+    c->done   = calloc(pl->cnt ? pl->cnt : 1, 1);
+}
+
+void ckpt_free(Checkpoint *c)
+{
+    free(c->done);
+    memset(c, 0, sizeof *c);
+}
+
+int ckpt_done_count(const Checkpoint *c)
+{
+    int n = 0;
+    for (int i = 0; i < c->cnt; ++i) n += c->done[i];
+    return n;
+}
+
+int ckpt_load(Checkpoint *c, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return 1;
+
+    char line[256];
+    unsigned params;
+    int depth, cnt, ndone;
+    uint64_t hash;
+    if (!fgets(line, sizeof line, f) || strncmp(line, CKPT_MAGIC, strlen(CKPT_MAGIC)) ||
+        fscanf(f, " params %u", &params) != 1 ||
+        fscanf(f, " prefixes %d %d %" SCNu64, &depth, &cnt, &hash) != 3 ||
+        fscanf(f, " output %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64,
+               &c->out_bytes, &c->canon, &c->written, &c->nodes) != 4 ||
+        fscanf(f, " done %d", &ndone) != 1)
+        goto bad;
+
+    if (params != c->params || depth != c->depth || cnt != c->cnt ||
+        hash != c->hash) {
+        fprintf(stderr, "%s: written by a run with other options or work\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    for (int i = 0; i < c->cnt; i += 4) {
+        int ch;
+        do ch = fgetc(f); while (ch == ' ' || ch == '\n' || ch == '\r');
+        int v = ch >= '0' && ch <= '9' ? ch - '0'
+              : ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 : -1;
+        if (v < 0) goto bad;
+        for (int k = 0; k < 4 && i + k < c->cnt; ++k)
+            c->done[i + k] = (v >> k) & 1;
+    }
+    if (ckpt_done_count(c) != ndone) goto bad;
+    fclose(f);
+    return 0;
+
+bad:
+    fclose(f);
+    fprintf(stderr, "%s: malformed checkpoint\n", path);
+    return -1;
+}
+
+int ckpt_save(const Checkpoint *c, const char *path)
+{
+    char tmp[512];
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) { perror(tmp); return -1; }
+
+    fprintf(f, CKPT_MAGIC "\n"
+               "params %u\n"
+               "prefixes %d %d %" PRIu64 "\n"
+               "output %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 "\n"
+               "done %d\n",
+            (unsigned)c->params, c->depth, c->cnt, c->hash,
+            c->out_bytes, c->canon, c->written, c->nodes, ckpt_done_count(c));
+    for (int i = 0, n = 0; i < c->cnt; i += 4) {
+        int v = 0;
+        for (int k = 0; k < 4 && i + k < c->cnt; ++k)
+            v |= c->done[i + k] << k;
+        fputc("0123456789abcdef"[v], f);
+        if (++n % HEX_PER_LINE == 0 || i + 4 >= c->cnt) fputc('\n', f);
+    }
+
+    uint64_t bytes;
+    int rc = ckpt_sync(f, &bytes);
+    if (fclose(f) != 0) rc = -1;
+    if (rc != 0) { perror(tmp); remove(tmp); return -1; }
+#ifdef _WIN32
+    remove(path);                       /* rename() does not replace */
+#endif
+    if (rename(tmp, path) != 0) { perror(path); return -1; }
+    return 0;
+}
+
+int ckpt_sync(FILE *fp, uint64_t *bytes)
+{
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) return -1;
+    *bytes = (uint64_t)ftello(fp);
+    return 0;
+}
+
+FILE *ckpt_reopen(const char *path, uint64_t bytes)
+{
+    FILE *fp = fopen(path, "r+b");
+    if (!fp) { perror(path); return NULL; }
+    if (fseeko(fp, 0, SEEK_END) != 0 || (uint64_t)ftello(fp) < bytes) {
+        fprintf(stderr, "%s: shorter than its checkpoint\n", path);
+        fclose(fp);
+        return NULL;
+    }
+    if (ftruncate(fileno(fp), bytes) != 0 || fseeko(fp, bytes, SEEK_SET) != 0) {
+        perror(path);
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
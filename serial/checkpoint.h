@@ -0,0 +1,52 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "worklist.h"
+
+/* Progress of a search over a prefix list, saved now and then so that a
+   killed run can resume. done[i] is set once prefix i has been searched
+   completely; out_bytes, canon, written and nodes are the size of the
+   output file and the counters at that moment. A resumed run cuts the
+   output back to out_bytes, restores the counters and skips the finished
+   prefixes, so no solution is lost or written twice.
+
+   params identifies the run (output format, rank count, ...) and, like
+   the prefix list, must match on resume. The file is text:
+
+     iqfit-checkpoint 1
+     params <params>
+     prefixes <depth> <count> <hash of the list>
+     output <out_bytes> <canon> <written> <nodes>
+     done <finished prefixes>
+     <done[] in hex, 4 prefixes per digit, 64 digits per line>
+
+   and is replaced atomically (written beside, then renamed). */
+
+typedef struct {
+    uint32_t  params;
+    int       depth, cnt;
+    uint64_t  hash;
+    uint64_t  out_bytes, canon, written, nodes;
+    uint8_t  *done;
+} Checkpoint;
+
+void ckpt_init(Checkpoint *c, const PrefixList *pl, uint32_t params);
+void ckpt_free(Checkpoint *c);
+int  ckpt_done_count(const Checkpoint *c);
+
+/* c must have been set up by ckpt_init() for the current run. Returns 0
+   when loaded, 1 when path does not exist and -1 (with a message) on a
+   malformed file or one written by a different run. */
+int  ckpt_load(Checkpoint *c, const char *path);
+int  ckpt_save(const Checkpoint *c, const char *path);
+
+/* Flushes fp through to the disk and returns its size in *bytes, so that
+   a checkpoint saved afterwards never covers data that was lost. */
+int   ckpt_sync(FILE *fp, uint64_t *bytes);
+/* Opens an existing output for appending after its first bytes; anything
+   past them is cut off. NULL (with a message) if it is shorter. */
+FILE *ckpt_reopen(const char *path, uint64_t bytes);
+
+#endif
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+#include "dlx.h"
+
+#define NCOLS (BOARD_CELLS + NUM_PIECES)
+
+/* Node 0 is the root, nodes 1..NCOLS the column headers, then one node per
+   piece and cell of each row. */
+struct Dlx {
+    int *L, *R, *U, *D, *C, *row;
+    int  S[NCOLS + 1];
+    int *row_head;              /* first node (the piece column) of a row */
+    int  sel[NUM_PIECES];
+    uint64_t nodes, found;
+    int  stop;
+    DlxSolutionFn fn;
+    void *ctx;
+};
+
+static void link_row(Dlx *d, int n, int col, int r)
+{
+    d->C[n] = col;
+    d->row[n] = r;
+    d->U[n] = d->U[col];
+    d->D[n] = col;
+    d->D[d->U[col]] = n;
+    d->U[col] = n;
+    ++d->S[col];
+}
+
+Dlx *dlx_create(void)
+{
+    int total = 1 + NCOLS;
+    for (int i = 0; i < place_cnt; ++i)
+        total += 1 + __builtin_popcountll(place[i].mask);
+
+    Dlx *d = calloc(1, sizeof *d);
+    if (!d) return NULL;
+    int *mem = malloc(6 * (size_t)total * sizeof *mem);
+    d->row_head = malloc(place_cnt * sizeof *d->row_head);
+    if (!mem || !d->row_head) {
+        free(mem);
+        free(d->row_head);
+        free(d);
+        return NULL;
+    }
+    d->L = mem;             d->R = mem + total;     d->U = mem + 2*total;
+    d->D = mem + 3*total;   d->C = mem + 4*total;   d->row = mem + 5*total;
+
+    for (int c = 0; c <= NCOLS; ++c) {
+        d->L[c] = c ? c-1 : NCOLS;
+        d->R[c] = c < NCOLS ? c+1 : 0;
+        d->U[c] = d->D[c] = d->C[c] = c;
+        d->row[c] = -1;
+    }
+
+    int n = NCOLS + 1;
+    for (int i = 0; i < place_cnt; ++i) {
+        int first = n;
+        d->row_head[i] = first;
+        link_row(d, n++, 1 + BOARD_CELLS + place[i].piece, i);
+        for (uint64_t m = place[i].mask; m; m &= m-1)
+            link_row(d, n++, 1 + __builtin_ctzll(m), i);
+        for (int k = first; k < n; ++k) {
+            d->L[k] = k > first ? k-1 : n-1;
+            d->R[k] = k < n-1 ? k+1 : first;
+        }
+    }
+    return d;
+}
+
+void dlx_free(Dlx *d)
+{
+    if (!d) return;
+    free(d->L);
+    free(d->row_head);
+    free(d);
+}
+
+uint64_t dlx_nodes(const Dlx *d)
+{
+    return d->nodes;
+}
+
+static void cover(Dlx *d, int c)
+{
+    int *L = d->L, *R = d->R, *U = d->U, *D = d->D;
+    R[L[c]] = R[c];
+    L[R[c]] = L[c];
+    for (int i = D[c]; i != c; i = D[i])
+        for (int j = R[i]; j != i; j = R[j]) {
+            D[U[j]] = D[j];
+            U[D[j]] = U[j];
+            --d->S[d->C[j]];
+        }
+}
+
+static void uncover(Dlx *d, int c)
+{
+    int *L = d->L, *R = d->R, *U = d->U, *D = d->D;
+    for (int i = U[c]; i != c; i = U[i])
+        for (int j = L[i]; j != i; j = L[j]) {
+            ++d->S[d->C[j]];
+            D[U[j]] = j;
+            U[D[j]] = j;
+        }
+    R[L[c]] = c;
+    L[R[c]] = c;
+}
+
+static void select_row(Dlx *d, int r)
+{
+    int j = r;
+    do { cover(d, d->C[j]); j = d->R[j]; } while (j != r);
+}
+
+static void unselect_row(Dlx *d, int r)
+{
+    int j = r;
+    do { j = d->L[j]; uncover(d, d->C[j]); } while (j != r);
+}
+
+static void search(Dlx *d, int k)
+{
+    ++d->nodes;
+
+    if (d->R[0] == 0) {
+        ++d->found;
+        if (d->fn) {
+            uint64_t occ_piece[NUM_PIECES];
+            for (int i = 0; i < k; ++i)
+                occ_piece[place[d->sel[i]].piece] = place[d->sel[i]].mask;
+            d->stop = d->fn(d->ctx, occ_piece) != 0;
+        }
+        return;
+    }
+
+    /* minimum remaining values: the column with the fewest rows left */
+    int c = d->R[0];
+    for (int j = d->R[c]; j != 0 && d->S[c]; j = d->R[j])
+        if (d->S[j] < d->S[c]) c = j;
+    if (!d->S[c]) return;
+
+    cover(d, c);
+    for (int r = d->D[c]; r != c; r = d->D[r]) {
+        d->sel[k] = d->row[r];
+        for (int j = d->R[r]; j != r; j = d->R[j]) cover(d, d->C[j]);
+        search(d, k+1);
+        for (int j = d->L[r]; j != r; j = d->L[j]) uncover(d, d->C[j]);
+        if (d->stop) break;
+    }
+    uncover(d, c);
+}
+
+uint64_t dlx_solve(Dlx *d, const uint16_t *prefix, int depth,
+                   DlxSolutionFn fn, void *ctx)
+{
+    d->fn = fn;
+    d->ctx = ctx;
+    d->found = 0;
+    d->stop = 0;
+
+    for (int i = 0; i < depth; ++i) {
+        d->sel[i] = prefix[i];
+        select_row(d, d->row_head[prefix[i]]);
+    }
+    search(d, depth);
+    for (int i = depth - 1; i >= 0; --i)
+        unselect_row(d, d->row_head[prefix[i]]);
+
+    return d->found;
+}
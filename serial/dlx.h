@@ -0,0 +1,25 @@
+#ifndef DLX_H
+#define DLX_H
+
+#include <stdint.h>
+#include "init.h"
+
+/* Dancing Links (Knuth's Algorithm X) over the exact cover matrix of the
+   puzzle: one primary column per cell and per piece, one row per entry of
+   place[]. Branches on the column with the fewest remaining rows. */
+
+typedef struct Dlx Dlx;
+
+/* Called with the piece masks of every solution, as IqSolutionFn. A
+   nonzero return stops the current dlx_solve() call. */
+typedef int (*DlxSolutionFn)(void *ctx, const uint64_t occ_piece[NUM_PIECES]);
+
+Dlx     *dlx_create(void);
+void     dlx_free(Dlx *d);
+/* Solves below the placements prefix[0..depth-1]; fn may be NULL to count.
+   Returns the number of (canonical) solutions found. */
+uint64_t dlx_solve(Dlx *d, const uint16_t *prefix, int depth,
+                   DlxSolutionFn fn, void *ctx);
+uint64_t dlx_nodes(const Dlx *d);
+
+#endif
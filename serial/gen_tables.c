@@ -0,0 +1,135 @@
+/* Writes tables.h: the tables init_all() and build_tables() compute, as
+   constant data for builds with -DIQ_STATIC_TABLES.
+
+   gcc -O2 -std=c11 gen_tables.c init.c -o gen_tables && ./gen_tables > tables.h */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "init.h"
+
+static void put_u64s(const char *decl, const uint64_t *v, int n)
+{
+    printf("%s = {", decl);
+    for (int i = 0; i < n; ++i)
+        printf("%s0x%016" PRIx64 "ULL,", i % 4 ? " " : "\n    ", v[i]);
+    printf("\n};\n\n");
+}
+
+static void put_ints(const char *decl, const int *v, int n)
+{
+    printf("%s = {", decl);
+    for (int i = 0; i < n; ++i)
+        printf("%s%d,", i % 16 ? " " : "\n    ", v[i]);
+    printf("\n};\n\n");
+}
+
+static int by_mask(const void *a, const void *b)
+{
+    uint64_t x = place[*(const int *)a].mask, y = place[*(const int *)b].mask;
+    return (x > y) - (x < y);
+}
+
+int main(void)
+{
+    init_all();
+    build_tables();
+
+    printf("/* Generated by gen_tables.c, do not edit. */\n\n");
+
+    printf("const Orient orient[NUM_PIECES][MAX_ORIENTS] = {\n");
+    for (int p = 0; p < NUM_PIECES; ++p) {
+        printf("    {");
+        for (int o = 0; o < orient_cnt[p]; ++o) {
+            printf("%s{{", o ? ",\n     " : "");
+            for (int r = 0; r < 4; ++r) {
+                const int *row = orient[p][o].shape[r];
+                printf("%s{%d,%d,%d,%d}", r ? "," : "", row[0], row[1], row[2], row[3]);
+            }
+            printf("}, %d, %d}", orient[p][o].w, orient[p][o].h);
+        }
+        printf("},\n");
+    }
+    printf("};\n\n");
+    put_ints("const int orient_cnt[NUM_PIECES]", orient_cnt, NUM_PIECES);
+
+    printf("static const Placement place_table[%d] = {", place_cnt);
+    for (int i = 0; i < place_cnt; ++i)
+        printf("%s{0x%016" PRIx64 "ULL, %d},", i % 3 ? " " : "\n    ",
+               place[i].mask, place[i].piece);
+    printf("\n};\n\n");
+    printf("const Placement *const place = place_table;\n");
+    printf("const int place_cnt = %d;\n\n", place_cnt);
+    put_ints("const int p_first[NUM_PIECES]", p_first, NUM_PIECES);
+    put_ints("const int p_count[NUM_PIECES]", p_count, NUM_PIECES);
+
+    put_u64s("const uint64_t neighbor_masks[BOARD_CELLS]", neighbor_masks, BOARD_CELLS);
+    printf("const uint64_t FULL_MASK = 0x%016" PRIx64 "ULL;\n\n", FULL_MASK);
+
+    int total = 0;
+    int *by_cell = malloc(BOARD_CELLS * place_cnt * sizeof *by_cell);
+    int offset[BOARD_CELLS];
+    for (int b = 0; b < BOARD_CELLS; ++b) {
+        offset[b] = total;
+        for (int k = 0; k < placements_by_cell_cnt[b]; ++k)
+            by_cell[total++] = placements_by_cell[b][k];
+    }
+    char decl[128];
+    snprintf(decl, sizeof decl, "static const int by_cell_table[%d]", total);
+    put_ints(decl, by_cell, total);
+    printf("const int *const placements_by_cell[BOARD_CELLS] = {");
+    for (int b = 0; b < BOARD_CELLS; ++b)
+        printf("%sby_cell_table + %d,", b % 6 ? " " : "\n    ", offset[b]);
+    printf("\n};\n\n");
+    put_ints("const int placements_by_cell_cnt[BOARD_CELLS]",
+             placements_by_cell_cnt, BOARD_CELLS);
+
+    int *v = malloc(place_cnt * sizeof *v);
+    for (int i = 0; i < place_cnt; ++i) v[i] = idx_pid[i];
+    snprintf(decl, sizeof decl, "static const uint8_t idx_pid_table[%d]", place_cnt);
+    put_ints(decl, v, place_cnt);
+    printf("const uint8_t *const idx_pid = idx_pid_table;\n\n");
+
+    snprintf(decl, sizeof decl, "static const uint64_t anchor_table[%d]", place_cnt + 8);
+    put_u64s(decl, anchor_mask, place_cnt + 8);
+    printf("const uint64_t *const anchor_mask = anchor_table;\n\n");
+    int starts[BOARD_CELLS*NUM_PIECES + 1];
+    for (int g = 0; g <= BOARD_CELLS*NUM_PIECES; ++g) starts[g] = anchor_start[g];
+    put_ints("const uint16_t anchor_start[BOARD_CELLS*NUM_PIECES + 1]",
+             starts, BOARD_CELLS*NUM_PIECES + 1);
+    for (int i = 0; i < place_cnt; ++i) v[i] = anchor_idx[i];
+    snprintf(decl, sizeof decl, "static const uint16_t anchor_idx_table[%d]", place_cnt);
+    put_ints(decl, v, place_cnt);
+    printf("const uint16_t *const anchor_idx = anchor_idx_table;\n\n");
+
+    int sizes[NUM_PIECES];
+    for (int p = 0; p < NUM_PIECES; ++p) sizes[p] = piece_size[p];
+    put_ints("const uint8_t piece_size[NUM_PIECES]", sizes, NUM_PIECES);
+    put_u64s("const uint64_t subset_sums[1<<NUM_PIECES]", subset_sums, 1<<NUM_PIECES);
+
+    snprintf(decl, sizeof decl, "static const uint64_t sym_mask_table[%d]", sym_place_cnt);
+    put_u64s(decl, sym_mask, sym_place_cnt);
+    printf("const uint64_t *const sym_mask = sym_mask_table;\n");
+    printf("const int sym_place_cnt = %d;\n\n", sym_place_cnt);
+    int *sp = malloc(4 * place_cnt * sizeof *sp);
+    for (int i = 0; i < 4 * place_cnt; ++i) sp[i] = sym_place[i];
+    snprintf(decl, sizeof decl, "static const uint16_t sym_place_table[%d]", 4 * place_cnt);
+    put_ints(decl, sp, 4 * place_cnt);
+    printf("const uint16_t *const sym_place = sym_place_table;\n\n");
+    free(sp);
+
+    /* place_index() searches the masks in sorted order */
+    for (int i = 0; i < place_cnt; ++i) v[i] = i;
+    qsort(v, place_cnt, sizeof *v, by_mask);
+    uint64_t *sorted = malloc(place_cnt * sizeof *sorted);
+    for (int i = 0; i < place_cnt; ++i) sorted[i] = place[v[i]].mask;
+    snprintf(decl, sizeof decl, "static const uint64_t sorted_masks[%d]", place_cnt);
+    put_u64s(decl, sorted, place_cnt);
+    snprintf(decl, sizeof decl, "static const int sorted_idx[%d]", place_cnt);
+    put_ints(decl, v, place_cnt);
+
+    free(sorted);
+    free(v);
+    free(by_cell);
+    free_tables();
+    return 0;
+}
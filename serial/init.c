@@ -3,11 +3,24 @@
 #include <string.h>
 #include "init.h"
 
+const char piece_sym[NUM_PIECES] =
+        {'Y','O','R','L','P','U','B','C','A','X','D','G'};
+
+int      prune_regions = 0;
+int      branch_constrained = 0;
+
+#ifdef IQ_STATIC_TABLES
+
+#include "tables.h"
+
+void init_all(void) {}
+void build_tables(void) {}
+void free_tables(void) {}
+
+#else
 
 Orient orient[NUM_PIECES][MAX_ORIENTS];
 int orient_cnt[NUM_PIECES] = {0};
-const char piece_sym[NUM_PIECES] =
-        {'Y','O','R','L','P','U','B','C','A','X','D','G'};
 
 static int same_shape(const int a[4][4], const int b[4][4])
 {
@@ -147,4 +160,154 @@ void init_all(void)
         gen_orients(i, bases[i]);
 
     gen_placements();
-}
\ No newline at end of file
+}
+
+
+uint64_t neighbor_masks[BOARD_CELLS];
+uint64_t FULL_MASK;
+
+int *placements_by_cell[BOARD_CELLS];
+int  placements_by_cell_cnt[BOARD_CELLS];
+
+uint8_t *idx_pid;
+
+uint64_t *anchor_mask;
+uint16_t *anchor_idx;
+uint16_t  anchor_start[BOARD_CELLS*NUM_PIECES + 1];
+
+static uint64_t *sorted_masks;
+static int      *sorted_idx;
+
+uint8_t  piece_size[NUM_PIECES];
+uint64_t subset_sums[1<<NUM_PIECES];
+
+uint64_t *sym_mask;
+uint16_t *sym_place;
+int       sym_place_cnt;
+
+static int by_mask(const void *a, const void *b)
+{
+    uint64_t x = place[*(const int *)a].mask, y = place[*(const int *)b].mask;
+    return (x > y) - (x < y);
+}
+
+void build_tables(void)
+{
+    FULL_MASK = (BOARD_CELLS==64)?~0ULL:((1ULL<<BOARD_CELLS)-1);
+
+    for (int r=0;r<BOARD_H;++r)
+        for (int c=0;c<BOARD_W;++c) {
+            int bit = r*BOARD_W + c;
+            uint64_t N = 0;
+            if (r)               N |= 1ULL<<(bit-BOARD_W);
+            if (r+1<BOARD_H)     N |= 1ULL<<(bit+BOARD_W);
+            if (c)               N |= 1ULL<<(bit-1);
+            if (c+1<BOARD_W)     N |= 1ULL<<(bit+1);
+            neighbor_masks[bit]=N;
+        }
+
+    idx_pid = malloc(place_cnt);
+    for (int pid=0; pid<NUM_PIECES; ++pid)
+        for (int i=p_first[pid]; i<p_first[pid]+p_count[pid]; ++i)
+            idx_pid[i]=pid;
+
+    for (int pid=0; pid<NUM_PIECES; ++pid)
+        piece_size[pid] = __builtin_popcountll(place[p_first[pid]].mask);
+
+    subset_sums[0] = 1;
+    for (uint32_t m=1; m<(1u<<NUM_PIECES); ++m) {
+        int low = __builtin_ctzll(m);
+        uint64_t rest = subset_sums[m & (m-1)];
+        subset_sums[m] = rest | (rest << piece_size[low]);
+    }
+
+    sorted_masks = malloc(place_cnt * sizeof *sorted_masks);
+    sorted_idx   = malloc(place_cnt * sizeof *sorted_idx);
+    for (int i=0; i<place_cnt; ++i) sorted_idx[i] = i;
+    qsort(sorted_idx, place_cnt, sizeof *sorted_idx, by_mask);
+    for (int i=0; i<place_cnt; ++i) sorted_masks[i] = place[sorted_idx[i]].mask;
+
+    memset(placements_by_cell_cnt,0,sizeof(placements_by_cell_cnt));
+    for (int idx=0; idx<place_cnt; ++idx) {
+        uint64_t m = place[idx].mask;
+        while (m){ int b=__builtin_ctzll(m);
+                   ++placements_by_cell_cnt[b]; m&=m-1; }
+    }
+    for (int b=0;b<BOARD_CELLS;++b)
+        placements_by_cell[b]=malloc(placements_by_cell_cnt[b]*sizeof(int)),
+        placements_by_cell_cnt[b]=0;
+
+    for (int idx=0; idx<place_cnt; ++idx) {
+        uint64_t m = place[idx].mask;
+        while (m){ int b=__builtin_ctzll(m);
+                   placements_by_cell[b][ placements_by_cell_cnt[b]++ ] = idx;
+                   m&=m-1; }
+    }
+
+    /* counting sort by (anchor cell, piece); place[] is already grouped by
+       piece, so each group keeps place[] order */
+    memset(anchor_start,0,sizeof(anchor_start));
+    for (int idx=0; idx<place_cnt; ++idx)
+        ++anchor_start[__builtin_ctzll(place[idx].mask)*NUM_PIECES + idx_pid[idx] + 1];
+    for (int g=0; g<BOARD_CELLS*NUM_PIECES; ++g)
+        anchor_start[g+1] += anchor_start[g];
+
+    uint16_t fill[BOARD_CELLS*NUM_PIECES];
+    memcpy(fill, anchor_start, sizeof fill);
+    anchor_mask = calloc(place_cnt + 8, sizeof *anchor_mask);
+    anchor_idx  = malloc(place_cnt * sizeof *anchor_idx);
+    for (int idx=0; idx<place_cnt; ++idx) {
+        int g = __builtin_ctzll(place[idx].mask)*NUM_PIECES + idx_pid[idx];
+        anchor_idx[fill[g]] = (uint16_t)idx;
+        anchor_mask[fill[g]++] = place[idx].mask;
+    }
+
+    /* images of the canonical placements; the ones outside place[] are
+       appended once each */
+    sym_mask  = malloc(4 * place_cnt * sizeof *sym_mask);
+    sym_place = malloc(4 * place_cnt * sizeof *sym_place);
+    for (int idx=0; idx<place_cnt; ++idx) sym_mask[idx] = place[idx].mask;
+    sym_place_cnt = place_cnt;
+    for (int idx=0; idx<place_cnt; ++idx)
+        for (int s=0; s<4; ++s) {
+            uint64_t m = mask_transform(place[idx].mask, s);
+            int k = place_index(m);
+            if (k < 0) {
+                k = place_cnt;
+                while (k < sym_place_cnt && sym_mask[k] != m) ++k;
+                if (k == sym_place_cnt) sym_mask[sym_place_cnt++] = m;
+            }
+            sym_place[4*idx + s] = (uint16_t)k;
+        }
+}
+
+void free_tables(void)
+{
+    free(place);
+    free(idx_pid);
+    free(anchor_mask);
+    free(anchor_idx);
+    free(sorted_masks);
+    free(sorted_idx);
+    free(sym_mask);
+    free(sym_place);
+    for (int b=0;b<BOARD_CELLS;++b) free(placements_by_cell[b]);
+
+    /* init_all() appends to place[], so a later rebuild starts empty */
+    place = NULL;
+    place_cnt = 0;
+}
+
+#endif
+
+/* Index into place[] of the placement with this mask, or -1. */
+int place_index(uint64_t mask)
+{
+    int lo = 0, hi = place_cnt - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (sorted_masks[mid] == mask) return sorted_idx[mid];
+        if (sorted_masks[mid] < mask) lo = mid + 1; else hi = mid - 1;
+    }
+    return -1;
+}
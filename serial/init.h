@@ -3,6 +3,20 @@
 
 #include <stdint.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#pragma intrinsic(_BitScanForward64)
+
+static inline int ctzll(uint64_t x) {
+    if (x == 0) return 64;
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+}
+#define __builtin_ctzll(x) ctzll(x)
+#define __builtin_popcountll(x) ((int)__popcnt64(x))
+#endif
+
 #define BOARD_W 11
 #define BOARD_H 5
 #define BOARD_CELLS (BOARD_W * BOARD_H)
@@ -14,21 +28,329 @@ typedef struct {
     int w, h;
 } Orient;
 
-extern Orient orient[NUM_PIECES][MAX_ORIENTS];
-extern int orient_cnt[NUM_PIECES];
-
-extern const char piece_sym[NUM_PIECES];
-
 typedef struct {
     uint64_t mask;
     uint8_t  piece;
 } Placement;
 
-extern Placement *place;
-extern int place_cnt;
-extern int p_first[NUM_PIECES];
-extern int p_count[NUM_PIECES];
+/* Built with -DIQ_STATIC_TABLES the tables below are defined by tables.h,
+   which gen_tables writes at build time, and are read-only data; otherwise
+   init_all() and build_tables() compute them at startup. */
+#ifdef IQ_STATIC_TABLES
+#define TABLE_CONST const
+#else
+#define TABLE_CONST
+#endif
+
+extern TABLE_CONST Orient orient[NUM_PIECES][MAX_ORIENTS];
+extern TABLE_CONST int orient_cnt[NUM_PIECES];
+
+extern const char piece_sym[NUM_PIECES];
+
+extern TABLE_CONST Placement *TABLE_CONST place;
+extern TABLE_CONST int place_cnt;
+extern TABLE_CONST int p_first[NUM_PIECES];
+extern TABLE_CONST int p_count[NUM_PIECES];
+
+extern TABLE_CONST uint64_t neighbor_masks[BOARD_CELLS];
+extern TABLE_CONST uint64_t FULL_MASK;
+
+extern TABLE_CONST int *TABLE_CONST placements_by_cell[BOARD_CELLS];
+extern TABLE_CONST int  placements_by_cell_cnt[BOARD_CELLS];
+
+extern TABLE_CONST uint8_t *TABLE_CONST idx_pid;
+
+/* Placements anchored at each cell, i.e. whose lowest set bit is that
+   cell, grouped by piece: group g = cell*NUM_PIECES + piece holds the
+   masks anchor_mask[anchor_start[g] .. anchor_start[g+1]-1], in place[]
+   order. The array is padded so fit_lanes() may read past a group. */
+extern TABLE_CONST uint64_t *TABLE_CONST anchor_mask;
+extern TABLE_CONST uint16_t anchor_start[BOARD_CELLS*NUM_PIECES + 1];
+/* place[] index of each anchor_mask entry. */
+extern TABLE_CONST uint16_t *TABLE_CONST anchor_idx;
+
+/* Placements under the board symmetries: sym_place[4*i + s] is the index
+   in sym_mask[] of placement i under symmetry s (the SYM_* codes of
+   solfile.h). sym_mask[] starts with the place[] masks; the images that
+   are not canonical placements follow, up to sym_place_cnt. */
+extern TABLE_CONST uint64_t *TABLE_CONST sym_mask;
+extern TABLE_CONST uint16_t *TABLE_CONST sym_place;
+extern TABLE_CONST int sym_place_cnt;
+
+extern TABLE_CONST uint8_t  piece_size[NUM_PIECES];
+extern TABLE_CONST uint64_t subset_sums[1<<NUM_PIECES];
+/* Set once from the options before searching; SHOULD_PRUNE and
+   BRANCH_CELL read them for every search outside libiqfit. */
+extern int      prune_regions;
+extern int      branch_constrained;
 
 void init_all(void);
+void build_tables(void);
+void free_tables(void);
+int  place_index(uint64_t mask);
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define BOARD_BITS     (BOARD_CELLS==64 ? ~0ULL : ((1ULL<<BOARD_CELLS)-1))
+#define COL_FIRST_BITS (BOARD_BITS / ((1ULL<<BOARD_W)-1))
+#define COL_LAST_BITS  (COL_FIRST_BITS << (BOARD_W-1))
+
+/* Cells with at least one of their four neighbours in s. Shifting s by one
+   column/row handles every cell at once; the column masks stop horizontal
+   shifts from wrapping into the adjacent row. */
+static inline uint64_t neighbours(uint64_t s)
+{
+    return ((s >> 1) & ~COL_LAST_BITS)
+         | ((s << 1) & ~COL_FIRST_BITS)
+         |  (s >> BOARD_W)
+         |  (s << BOARD_W);
+}
+
+/* An empty cell is an orphan when none of its neighbours is empty. */
+static inline int orphan_1x1(uint64_t occ)
+{
+    uint64_t empty = ~occ & BOARD_BITS;
+    return (empty & ~neighbours(empty)) != 0;
+}
+
+/* Floods every connected empty region and rejects the node when a region's
+   size is not the total size of some subset of the unused pieces. */
+static inline int region_infeasible(uint64_t occ, uint32_t used_mask)
+{
+    uint64_t empty = ~occ & BOARD_BITS;
+    uint64_t sums  = subset_sums[~used_mask & ((1u<<NUM_PIECES)-1)];
+
+    while (empty) {
+        uint64_t region = empty & (0 - empty);
+        for (;;) {
+            uint64_t grown = (region | neighbours(region)) & empty;
+            if (grown == region) break;
+            region = grown;
+        }
+        if (!((sums >> __builtin_popcountll(region)) & 1)) return 1;
+        empty &= ~region;
+    }
+    return 0;
+}
+
+/* Candidate filter over the anchored masks: bit i of the result is set
+   when m[i] does not overlap occ, for FIT_LANES consecutive masks. */
+#if defined(__AVX512F__)
+#define FIT_LANES 8
+#else
+#define FIT_LANES 4
+#endif
+
+static inline unsigned fit_lanes_scalar(const uint64_t *m, uint64_t occ)
+{
+    unsigned bits = 0;
+    for (int i = 0; i < FIT_LANES; ++i) bits |= (unsigned)!(m[i] & occ) << i;
+    return bits;
+}
+
+#if defined(__AVX512F__)
+static inline unsigned fit_lanes(const uint64_t *m, uint64_t occ)
+{
+    return _mm512_testn_epi64_mask(_mm512_loadu_si512((const void *)m),
+                                   _mm512_set1_epi64((long long)occ));
+}
+#elif defined(__AVX2__)
+static inline unsigned fit_lanes(const uint64_t *m, uint64_t occ)
+{
+    __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)m),
+                                 _mm256_set1_epi64x((long long)occ));
+    v = _mm256_cmpeq_epi64(v, _mm256_setzero_si256());
+    return (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(v));
+}
+#else
+#define fit_lanes fit_lanes_scalar
+#endif
+
+/* Lanes of a FIT_LANES block that lie inside a group with left entries. */
+static inline unsigned lane_mask(int left)
+{
+    return left >= FIT_LANES ? (1u << FIT_LANES) - 1 : (1u << left) - 1;
+}
+
+/* Placements of unused pieces that cover cell and fit on the board;
+   counting stops at limit. */
+static inline int fit_count(int cell, uint64_t occ, uint32_t used_mask,
+                            int limit)
+{
+    const int *lst = placements_by_cell[cell];
+    int cnt = placements_by_cell_cnt[cell];
+    int n = 0;
+    for (int k = 0; k < cnt && n < limit; ++k) {
+        int idx = lst[k];
+        n += !((used_mask >> idx_pid[idx]) & 1) && !(place[idx].mask & occ);
+    }
+    return n;
+}
+
+/* The empty cell with the fewest fitting placements. Only the lowest empty
+   cell and the empty cells with at most two empty neighbours (corners,
+   pockets, corridors) are scored; a cell nothing fits ends the scan at
+   once and the node fails without branching. */
+static inline int most_constrained_cell(uint64_t occ, uint32_t used_mask)
+{
+    uint64_t e = ~occ & BOARD_BITS;
+    uint64_t a = (e >> 1) & ~COL_LAST_BITS;
+    uint64_t b = (e << 1) & ~COL_FIRST_BITS;
+    uint64_t c =  e >> BOARD_W;
+    uint64_t d = (e << BOARD_W) & BOARD_BITS;
+    uint64_t open3 = (a & b & (c|d)) | (c & d & (a|b));
+
+    int best   = __builtin_ctzll(e);
+    int best_n = fit_count(best, occ, used_mask, placements_by_cell_cnt[best]);
+    for (uint64_t m = e & ~open3 & ~(1ULL << best); m && best_n; m &= m-1) {
+        int cell = __builtin_ctzll(m);
+        int n = fit_count(cell, occ, used_mask, best_n);
+        if (n < best_n) { best = cell; best_n = n; }
+    }
+    return best;
+}
+
+/* Reference per-cell scan, kept for cross-checking and benchmarks. */
+static inline int orphan_1x1_scan(uint64_t occ)
+{
+    for (int p = 0; p < BOARD_CELLS; ++p)
+        if (!(occ & (1ULL<<p)) &&
+            (neighbor_masks[p] & occ) == neighbor_masks[p])
+            return 1;
+    return 0;
+}
+/* Board symmetries on cell masks: 180 degree rotation maps cell p to
+   BOARD_CELLS-1-p, i.e. a bit reversal; the vertical mirror swaps rows. */
+static inline uint64_t mask_rot180(uint64_t m)
+{
+    m = ((m >> 1)  & 0x5555555555555555ULL) | ((m & 0x5555555555555555ULL) << 1);
+    m = ((m >> 2)  & 0x3333333333333333ULL) | ((m & 0x3333333333333333ULL) << 2);
+    m = ((m >> 4)  & 0x0F0F0F0F0F0F0F0FULL) | ((m & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    m = ((m >> 8)  & 0x00FF00FF00FF00FFULL) | ((m & 0x00FF00FF00FF00FFULL) << 8);
+    m = ((m >> 16) & 0x0000FFFF0000FFFFULL) | ((m & 0x0000FFFF0000FFFFULL) << 16);
+    m = (m >> 32) | (m << 32);
+    return m >> (64 - BOARD_CELLS);
+}
+
+static inline uint64_t mask_vflip(uint64_t m)
+{
+    const uint64_t row = (1ULL<<BOARD_W)-1;
+    uint64_t out = 0;
+    for (int r = 0; r < BOARD_H; ++r)
+        out |= ((m >> (r*BOARD_W)) & row) << ((BOARD_H-1-r)*BOARD_W);
+    return out;
+}
+
+static inline uint64_t mask_hflip(uint64_t m)
+{
+    return mask_vflip(mask_rot180(m));
+}
+
+/* Symmetry s: 0 identity, 1 horizontal mirror, 2 vertical mirror,
+   3 180 degree rotation (the SYM_* codes of solfile.h). */
+static inline uint64_t mask_transform(uint64_t m, int s)
+{
+    switch (s) {
+    case 1:  return mask_hflip(m);
+    case 2:  return mask_vflip(m);
+    case 3:  return mask_rot180(m);
+    default: return m;
+    }
+}
+
+/* Bit s-1 is set when symmetry s maps every piece onto itself. */
+static inline int solution_stabiliser(const uint64_t occ_piece[NUM_PIECES])
+{
+    int h = 1, v = 1, r = 1;
+    for (int pid = 0; pid < NUM_PIECES; ++pid) {
+        uint64_t m = occ_piece[pid];
+        uint64_t rot = mask_rot180(m);
+        h &= mask_vflip(rot) == m;
+        v &= mask_vflip(m) == m;
+        r &= rot == m;
+    }
+    return h | v << 1 | r << 2;
+}
+
+/* The same on a solution given as the place[] index of every piece: a
+   symmetry fixes the solution when it maps every placement to itself. */
+static inline int solution_stabiliser_ids(const uint16_t id[NUM_PIECES])
+{
+    int st = 0;
+    for (int s = 1; s < 4; ++s) {
+        int fixed = 1;
+        for (int pid = 0; pid < NUM_PIECES && fixed; ++pid)
+            fixed = sym_place[4*id[pid] + s] == id[pid];
+        st |= fixed << (s-1);
+    }
+    return st;
+}
+
+/* Number of distinct boards among a solution and its mirror images and
+   180 degree rotation: 4 divided by the size of its stabiliser. */
+static inline int solution_multiplicity(const uint64_t occ_piece[NUM_PIECES])
+{
+    return 4 / (1 + __builtin_popcountll(solution_stabiliser(occ_piece)));
+}
+
+/* The distinct variants of a solution with stabiliser st, in the order
+   emit() writes them. Two variants coincide exactly when their
+   composition (the third non-identity symmetry) fixes the solution. */
+static inline int stabiliser_variants(int st, int sym[4])
+{
+    int h = st & 1, v = st & 2, r = st & 4;
+    int n = 0;
+    sym[n++] = 0;
+    if (!h)             sym[n++] = 1;
+    if (!v && !r)       sym[n++] = 2;
+    if (!r && !v && !h) sym[n++] = 3;
+    return n;
+}
+
+static inline int solution_variants(const uint64_t occ_piece[NUM_PIECES],
+                                    int sym[4])
+{
+    return stabiliser_variants(solution_stabiliser(occ_piece), sym);
+}
+
+static inline int solution_variants_ids(const uint16_t id[NUM_PIECES],
+                                        int sym[4])
+{
+    return stabiliser_variants(solution_stabiliser_ids(id), sym);
+}
+
+/* place[] index of every piece of a solution, found among the (at most 8)
+   masks of its anchor group rather than by place_index(). Masks past the
+   group belong to other pieces or anchors and never match. */
+static inline void solution_ids(const uint64_t occ_piece[NUM_PIECES],
+                                uint16_t id[NUM_PIECES])
+{
+    for (int pid = 0; pid < NUM_PIECES; ++pid) {
+        uint64_t m = occ_piece[pid];
+        const uint64_t *g = &anchor_mask[anchor_start[__builtin_ctzll(m)*NUM_PIECES + pid]];
+        unsigned hit = 0;
+        for (int j = 0; j < 8; ++j) hit |= (unsigned)(g[j] == m) << j;
+        id[pid] = anchor_idx[g - anchor_mask + __builtin_ctzll(hit)];
+    }
+}
+
+/* The board of a solution under symmetry s, one piece letter per cell. */
+static inline void solution_board(const uint16_t id[NUM_PIECES], int s,
+                                  char board[BOARD_CELLS])
+{
+    for (int b = 0; b < BOARD_CELLS; ++b) board[b] = '.';
+    for (int pid = 0; pid < NUM_PIECES; ++pid)
+        for (uint64_t m = sym_mask[sym_place[4*id[pid] + s]]; m; m &= m-1)
+            board[__builtin_ctzll(m)] = piece_sym[pid];
+}
+
+#define SHOULD_PRUNE(m, u) \
+    (orphan_1x1(m) || (prune_regions && region_infeasible(m, u)))
+
+#define BRANCH_CELL(m, u) \
+    (branch_constrained ? most_constrained_cell(m, u) \
+                        : __builtin_ctzll(~(m) & FULL_MASK))
 
 #endif
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include "init.h"
+#include "challenge.h"
+#include "solindex.h"
+
+/* Placement queries over the full solution set.
+
+   build <solutions.bin> [-o <index>]   writes the bitmap index
+   query <index> <boards|-> [--list n]  each board is a conjunctive query:
+                                        the solutions with every piece it
+                                        shows in the same cells
+   bench <solutions.bin> [--queries n]  build time, index size and query
+                                        latency against a record scan
+
+   gcc -O3 -march=native -std=c11 iq_index.c init.c challenge.c solindex.c -o iq_index */
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s build <solutions.bin> [-o <index>]\n"
+            "       %s query <index> <boards|-> [--list <n>]\n"
+            "       %s bench <solutions.bin> [--queries <n>]\n",
+            prog, prog, prog);
+}
+
+static void print_stats(const SolIndex *ix, double sec)
+{
+    uint32_t bitmaps = 0, used = 0;
+    for (uint32_t c = 0; c < ix->h.chunks; ++c)
+        bitmaps += ix->chunk[c].card > SOLINDEX_ARRAY_MAX;
+    for (uint32_t k = 0; k < ix->h.keys; ++k)
+        used += ix->key_first[k+1] > ix->key_first[k];
+    size_t bytes = solindex_bytes(ix);
+    printf("Solutions: %" PRIu64 "\n"
+           "Placements: %" PRIu32 " (%" PRIu32 " used)\n"
+           "Chunks: %" PRIu32 " (%" PRIu32 " arrays, %" PRIu32 " bitmaps)\n"
+           "Index size: %.1f MB (%.2f bytes per solution)\n"
+           "Build time: %.2f s\n",
+           ix->h.solutions, ix->h.keys, used, ix->h.chunks,
+           ix->h.chunks - bitmaps, bitmaps, bytes / 1048576.0,
+           ix->h.solutions ? (double)bytes / ix->h.solutions : 0.0, sec);
+}
+
+static int run_build(const char *bin_path, const char *out_path)
+{
+    SolMap sm;
+    if (solmap_open(bin_path, &sm) != 0) return 1;
+
+    SolIndex ix;
+    double t0 = now();
+    solindex_build(&sm, &ix);
+    double sec = now() - t0;
+    solmap_close(&sm);
+
+    int rc = solindex_write(&ix, out_path);
+    if (!rc) {
+        print_stats(&ix, sec);
+        printf("Index written to %s\n", out_path);
+    }
+    solindex_free(&ix);
+    return rc ? 1 : 0;
+}
+
+static int run_query(const char *ix_path, const char *boards, uint64_t list)
+{
+    SolIndex ix;
+    if (solindex_open(ix_path, &ix) != 0) return 1;
+    ChallengeList cl = {0};
+    if (read_challenges(boards, &cl) != 0) { solindex_free(&ix); return 1; }
+
+    uint32_t *ids = list ? malloc(list * sizeof *ids) : NULL;
+    for (int q = 0; q < cl.cnt; ++q) {
+        const Challenge *c = &cl.items[q];
+        int keys[NUM_PIECES], n = 0, absent = 0;
+        for (int pid = 0; pid < NUM_PIECES; ++pid) {
+            if (!(c->used_mask & (1u<<pid))) continue;
+            int k = solindex_key(&ix, c->occ_piece[pid], pid);
+            if (k < 0) absent = 1;
+            keys[n++] = k;
+        }
+
+        double t0 = now();
+        uint64_t cnt = absent ? 0 : solindex_query(&ix, keys, n, ids, list);
+        double ms = (now() - t0) * 1e3;
+
+        printf("Query %d: %" PRIu64 " solutions (%.3f ms)\n", q+1, cnt, ms);
+        if (list && cnt) {
+            printf("  ");
+            for (uint64_t i = 0; i < cnt && i < list; ++i)
+                printf(" %" PRIu32, ids[i] + 1);
+            printf("%s\n", cnt > list ? " ..." : "");
+        }
+    }
+
+    free(ids);
+    free_challenges(&cl);
+    solindex_free(&ix);
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Random queries of 1-4 pieces, each taken from a random solution so no
+   result is empty, timed on the index and checked against a scan of the
+   records. */
+static int run_bench(const char *bin_path, int queries)
+{
+    SolMap sm;
+    if (solmap_open(bin_path, &sm) != 0) return 1;
+
+    SolIndex ix;
+    double t0 = now();
+    solindex_build(&sm, &ix);
+    print_stats(&ix, now() - t0);
+
+    uint32_t np = sm.h->place_cnt;
+    int *key_of = malloc(4 * np * sizeof *key_of);
+    for (uint32_t i = 0; i < np; ++i)
+        for (int s = 0; s < 4; ++s)
+            key_of[4*i + s] = solindex_key(&ix, mask_transform(sm.mask[i], s),
+                                           sm.piece[i]);
+
+    double  *lat = malloc(queries * sizeof *lat);
+    uint64_t rng = 88172645463325252ULL;
+    uint64_t n_sol = sm.h->count;
+    int fails = 0;
+
+    printf("\n| Pieces | Mean result | Index mean (ms) | Index p50 | Index p99 | Scan mean (ms) |\n"
+           "| ------ | ----------- | --------------- | --------- | --------- | -------------- |\n");
+    for (int terms = 1; terms <= 4 && n_sol; ++terms) {
+        double scan_sec = 0, results = 0;
+        for (int q = 0; q < queries; ++q) {
+            rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+            const uint16_t *rec = sm.rec + (rng % n_sol) * (NUM_PIECES + 1);
+            int pids[NUM_PIECES], keys[NUM_PIECES];
+            for (int p = 0; p < NUM_PIECES; ++p) pids[p] = p;
+            for (int t = 0; t < terms; ++t) {
+                rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+                int j = t + (int)(rng % (NUM_PIECES - t));
+                int tmp = pids[t]; pids[t] = pids[j]; pids[j] = tmp;
+                keys[t] = key_of[4*rec[pids[t]] + rec[NUM_PIECES]];
+            }
+
+            double t1 = now();
+            uint64_t cnt = solindex_query(&ix, keys, terms, NULL, 0);
+            lat[q] = (now() - t1) * 1e3;
+
+            t1 = now();
+            uint64_t ref = 0;
+            for (uint64_t r = 0; r < n_sol; ++r) {
+                const uint16_t *x = sm.rec + r * (NUM_PIECES + 1);
+                int t = 0;
+                while (t < terms &&
+                       key_of[4*x[pids[t]] + x[NUM_PIECES]] == keys[t]) ++t;
+                ref += t == terms;
+            }
+            scan_sec += now() - t1;
+
+            if (cnt != ref) ++fails;
+            results += cnt;
+        }
+
+        double mean = 0;
+        for (int q = 0; q < queries; ++q) mean += lat[q];
+        qsort(lat, queries, sizeof *lat, cmp_double);
+        printf("| %6d | %11.0f | %15.4f | %9.4f | %9.4f | %14.2f |\n",
+               terms, results / queries, mean / queries, lat[queries / 2],
+               lat[queries - 1 - queries / 100], scan_sec * 1e3 / queries);
+    }
+
+    if (fails)
+        fprintf(stderr, "FAILED: %d queries differ from the record scan\n", fails);
+    free(lat);
+    free(key_of);
+    solindex_free(&ix);
+    solmap_close(&sm);
+    return fails ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) { usage(argv[0]); return 1; }
+
+    const char *out_path = "solutions.iqx";
+    uint64_t list = 0;
+    int queries = 1000;
+    for (int i = 3; i < argc; ++i) {
+        if (!strcmp(argv[i], "-o") && i+1 < argc)
+            out_path = argv[++i];
+        else if (!strcmp(argv[i], "--list") && i+1 < argc)
+            list = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--queries") && i+1 < argc)
+            queries = atoi(argv[++i]);
+        else if (!strcmp(argv[1], "query") && i == 3)
+            continue;
+        else { usage(argv[0]); return 1; }
+    }
+
+    init_all();
+    build_tables();
+
+    int rc;
+    if (!strcmp(argv[1], "build"))
+        rc = run_build(argv[2], out_path);
+    else if (!strcmp(argv[1], "query") && argc > 3)
+        rc = run_query(argv[2], argv[3], list);
+    else if (!strcmp(argv[1], "bench") && queries > 0)
+        rc = run_bench(argv[2], queries);
+    else {
+        usage(argv[0]);
+        rc = 1;
+    }
+
+    free_tables();
+    return rc;
+}
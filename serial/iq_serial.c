@@ -5,170 +5,1119 @@
 #include <inttypes.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include "init.h"
+#include "worklist.h"
+#include "solfile.h"
+#include "writer.h"
+#include "memo.h"
+#include "dlx.h"
+#include "challenge.h"
+#include "iqfit.h"
+#include "puzzle.h"
+#include "checkpoint.h"
+#include "solrank.h"
 
-static uint64_t neighbor_masks[BOARD_CELLS];
-static uint64_t FULL_MASK;
+/* Where one search's solutions go: the callback context of its solver. */
+typedef struct {
+    FILE     *fp;
+    Writer   *writer;
+    uint64_t  sol_written;
+    uint64_t  canon_found;
+} Output;
 
-static int *placements_by_cell[BOARD_CELLS];
-static int placements_by_cell_cnt[BOARD_CELLS];
+static IqOptions opts;
+static int count_only = 0;
+static int binary_out = 0;
+static int async_out  = 0;
+static int canonical_out = 0;
+static int ckpt_every = 0;              /* seconds between checkpoints */
+static int resume     = 0;
 
-static uint8_t  *idx_pid;
+typedef enum { SOLVE_FIRST, SOLVE_ALL, SOLVE_COUNT } SolveMode;
 
-static inline int orphan_1x1(uint64_t occ)
+/* Result of one challenge; boards holds n boards of BOARD_CELLS chars. */
+typedef struct {
+    uint64_t count;
+    uint64_t nodes;
+    char    *boards;
+    size_t   n, cap;
+} ChallengeResult;
+
+/* Callback context of a challenge search: the query's result and the
+   symmetry its position was mapped through. */
+typedef struct {
+    ChallengeResult *r;
+    int              sym;
+} ChallengeCtx;
+
+static SolveMode solve_mode = SOLVE_ALL;
+
+#ifdef IQ_STATS
+/* Counters of every solver that ran, written as JSON at exit. */
+static IqStats         stats;
+static const char     *stats_path = "stats.json";
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void collect_stats(const IqSolver *solver)
 {
-    for (int p = 0; p < BOARD_CELLS; ++p)
-        if (!(occ & (1ULL<<p)) &&
-            (neighbor_masks[p] & occ) == neighbor_masks[p])
-            return 1;
-    return 0;
+    pthread_mutex_lock(&stats_lock);
+    iq_solver_stats(solver, &stats);
+    pthread_mutex_unlock(&stats_lock);
 }
-#define SHOULD_PRUNE(m)  orphan_1x1(m)
 
-static FILE     *fp_out;
-static uint64_t  sol_written = 0;
+static void write_stats(void)
+{
+    if (iq_stats_write(stats_path, &stats) == 0)
+        printf("Search statistics written to %s\n", stats_path);
+}
+#else
+#define collect_stats(solver) ((void)0)
+#endif
 
-static void dump_solution(char board[])
+static void dump_board(FILE *fp, uint64_t n, const char board[], int w, int h)
 {
-    ++sol_written;
-    fprintf(fp_out,"Solution %" PRIu64 ":\n", sol_written);
-    for (int r = 0; r < BOARD_H; ++r) {
-        for (int c = 0; c < BOARD_W; ++c)
-            fputc(board[r*BOARD_W+c], fp_out), fputc(' ', fp_out);
-        fputc('\n', fp_out);
+    fprintf(fp,"Solution %" PRIu64 ":\n", n);
+    for (int r = 0; r < h; ++r) {
+        for (int c = 0; c < w; ++c)
+            fputc(board[r*w+c], fp), fputc(' ', fp);
+        fputc('\n', fp);
     }
-    fputs("==========\n", fp_out);
+    fputs("==========\n", fp);
 }
-static void emit(uint64_t occ_piece[NUM_PIECES])
+
+static void dump_solution(Output *o, const char board[])
+{
+    dump_board(o->fp, ++o->sol_written, board, BOARD_W, BOARD_H);
+}
+
+/* The canonical solution and its distinct mirror images and rotation, or
+   with --canonical the canonical solution alone. */
+static int output_variants(const uint16_t id[NUM_PIECES], int sym[4])
+{
+    if (canonical_out) { sym[0] = SYM_ID; return 1; }
+    return solution_variants_ids(id, sym);
+}
+
+static void emit(Output *o, const uint64_t occ_piece[NUM_PIECES])
 {
+    uint16_t id[NUM_PIECES];
     char B[BOARD_CELLS];
-    char B_h_mir[BOARD_CELLS];
-    char B_v_mir[BOARD_CELLS];
-    char B_180_rot[BOARD_CELLS];
-
-    memset(B, '.', BOARD_CELLS);
-    for (int pid = 0; pid < NUM_PIECES; ++pid) {
-        uint64_t m = occ_piece[pid];
-        while (m) {
-            int b = __builtin_ctzll(m);
-            B[b] = piece_sym[pid];
-            m &= m - 1;
+    int sym[4];
+
+    solution_ids(occ_piece, id);
+    int n = output_variants(id, sym);
+    for (int i = 0; i < n; ++i) {
+        solution_board(id, sym[i], B);
+        dump_solution(o, B);
+    }
+}
+
+static void emit_binary(Output *o, const uint64_t occ_piece[NUM_PIECES])
+{
+    uint16_t rec[NUM_PIECES+1];
+    int sym[4];
+
+    solution_ids(occ_piece, rec);
+    int n = output_variants(rec, sym);
+    for (int i = 0; i < n; ++i) {
+        rec[NUM_PIECES] = (uint16_t)sym[i];
+        fwrite(rec, sizeof rec, 1, o->fp);
+    }
+    o->sol_written += n;
+}
+
+static int challenge_solution(void *ctx, const uint64_t occ_piece[NUM_PIECES])
+{
+    ChallengeCtx *cc = ctx;
+    ChallengeResult *r = cc->r;
+    if (!challenge_accept(occ_piece, cc->sym)) return 0;
+    ++r->count;
+    if (solve_mode == SOLVE_COUNT) return 0;
+    if (r->n == r->cap) {
+        r->cap = r->cap ? 2*r->cap : 4;
+        r->boards = realloc(r->boards, r->cap * BOARD_CELLS);
+    }
+    challenge_board(occ_piece, cc->sym, r->boards + r->n++ * BOARD_CELLS);
+    return solve_mode == SOLVE_FIRST;
+}
+
+static int solution(void *ctx, const uint64_t occ_piece[NUM_PIECES])
+{
+    Output *o = ctx;
+    ++o->canon_found;
+    if (count_only)      o->sol_written += solution_multiplicity(occ_piece);
+    else if (o->writer)  writer_push(o->writer, occ_piece);
+    else if (binary_out) emit_binary(o, occ_piece);
+    else                 emit(o, occ_piece);
+    return 0;
+}
+
+#define SPLIT_DEPTH 4
+#define OUT_BUF_SIZE (1 << 20)
+
+typedef struct {
+    uint64_t occ;
+    uint32_t used_mask;
+    uint64_t occ_piece[NUM_PIECES];
+} Task;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Task     *q;
+    int       head, tail, cap;
+    pthread_t tid;
+    int       id;
+    uint32_t  rng;
+    IqSolver *solver;
+    Output    out;
+    uint64_t  nodes;
+    uint64_t  tasks_run;
+    uint64_t  steals;
+    WriterStats ws;
+} Worker;
+
+static Worker      *workers;
+static int          n_workers;
+static atomic_int   idle_workers;
+static atomic_long  pending_tasks;
+
+static void push_task(Worker *w, const Task *t)
+{
+    atomic_fetch_add(&pending_tasks, 1);
+    pthread_mutex_lock(&w->lock);
+    if (w->tail == w->cap) {
+        w->cap = w->cap ? 2*w->cap : 64;
+        w->q = realloc(w->q, w->cap * sizeof *w->q);
+    }
+    w->q[w->tail++] = *t;
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* owner takes the newest (deepest) task, thieves take the oldest */
+static int pop_task(Worker *w, Task *t)
+{
+    int ok = 0;
+    pthread_mutex_lock(&w->lock);
+    if (w->tail > w->head) { *t = w->q[--w->tail]; ok = 1; }
+    if (w->tail == w->head) w->head = w->tail = 0;
+    pthread_mutex_unlock(&w->lock);
+    return ok;
+}
+
+static int steal_task(Worker *w, Task *t)
+{
+    w->rng ^= w->rng << 13; w->rng ^= w->rng >> 17; w->rng ^= w->rng << 5;
+    int start = w->rng % n_workers;
+    for (int i = 0; i < n_workers; ++i) {
+        Worker *v = &workers[(start + i) % n_workers];
+        if (v == w) continue;
+        int ok = 0;
+        pthread_mutex_lock(&v->lock);
+        if (v->tail > v->head) { *t = v->q[v->head++]; ok = 1; }
+        if (v->tail == v->head) v->head = v->tail = 0;
+        pthread_mutex_unlock(&v->lock);
+        if (ok) { ++w->steals; return 1; }
+    }
+    return 0;
+}
+
+/* Above SPLIT_DEPTH the solver offers every child to the worker's deque,
+   which takes it whenever some worker is idle. */
+static int offer_task(void *ctx, uint64_t occ, uint32_t used_mask,
+                      const uint64_t occ_piece[NUM_PIECES])
+{
+    Worker *w = ctx;
+    if (atomic_load_explicit(&idle_workers, memory_order_relaxed) == 0)
+        return 0;
+    Task t = { occ, used_mask, {0} };
+    memcpy(t.occ_piece, occ_piece, sizeof t.occ_piece);
+    push_task(w, &t);
+    return 1;
+}
+
+static void run_task(Worker *w, Task *t)
+{
+    ++w->tasks_run;
+    iq_solve(w->solver, t->occ, t->used_mask, t->occ_piece);
+    atomic_fetch_sub(&pending_tasks, 1);
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    if (async_out && w->out.fp) {
+        fflush(w->out.fp);
+        w->out.writer = writer_open(fileno(w->out.fp), binary_out, !canonical_out);
+    }
+
+    Task t;
+    for (;;) {
+        if (pop_task(w, &t) || steal_task(w, &t)) {
+            run_task(w, &t);
+            continue;
+        }
+        atomic_fetch_add(&idle_workers, 1);
+        int got = 0;
+        while (atomic_load(&pending_tasks) > 0) {
+            if ((got = steal_task(w, &t))) break;
+            sched_yield();
         }
+        atomic_fetch_sub(&idle_workers, 1);
+        if (!got) break;
+        run_task(w, &t);
     }
 
-    for (int r = 0; r < BOARD_H; ++r) {
-        for (int c = 0; c < BOARD_W; ++c) {
-            B_h_mir[r * BOARD_W + c] = B[r * BOARD_W + (BOARD_W - 1 - c)];
-            B_v_mir[r * BOARD_W + c] = B[(BOARD_H - 1 - r) * BOARD_W + c];
-            B_180_rot[r * BOARD_W + c] = B[(BOARD_H - 1 - r) * BOARD_W + (BOARD_W - 1 - c)];
+    if (w->out.writer) {
+        if (writer_close(w->out.writer, &w->ws) != 0)
+            fprintf(stderr, "[Thread %d] write error\n", w->id);
+        w->out.sol_written = w->ws.solutions;
+        w->out.writer = NULL;
+    }
+    w->nodes = iq_solver_nodes(w->solver);
+    return NULL;
+}
+
+static uint64_t merge_thread_files(FILE *out, const char *out_path)
+{
+    uint64_t total = 0;
+    char line[256];
+    char fname[512];
+
+    if (binary_out) {
+        static char buf[OUT_BUF_SIZE];
+        solfile_write_header(out, 0);
+        for (int i = 0; i < n_workers; ++i) {
+            snprintf(fname, sizeof(fname), "%s.t%d", out_path, i);
+            FILE *in = fopen(fname, "rb");
+            if (!in) continue;
+            size_t n;
+            while ((n = fread(buf, 1, sizeof buf, in)) > 0) {
+                fwrite(buf, 1, n, out);
+                total += n;
+            }
+            fclose(in);
+            if (remove(fname) != 0)
+                fprintf(stderr, "Warning: Could not delete %s\n", fname);
+        }
+        total /= (NUM_PIECES+1) * sizeof(uint16_t);
+        solfile_set_count(out, total);
+        return total;
+    }
+
+    for (int i = 0; i < n_workers; ++i) {
+        snprintf(fname, sizeof(fname), "%s.t%d", out_path, i);
+        FILE *in = fopen(fname, "r");
+        if (!in) continue;
+        while (fgets(line, sizeof(line), in)) {
+            if (strncmp(line, "Solution ", 9) == 0)
+                fprintf(out, "Solution %" PRIu64 ":\n", ++total);
+            else
+                fputs(line, out);
         }
+        fclose(in);
+        if (remove(fname) != 0)
+            fprintf(stderr, "Warning: Could not delete %s\n", fname);
+    }
+    return total;
+}
+
+static void print_writer_stats(const WriterStats *ws)
+{
+    printf("Writer: %.1f MB in %" PRIu64 " write() calls, "
+           "search stalled %" PRIu64 " times (%.3f s)\n",
+           ws->bytes / 1e6, ws->writes, ws->stalls, ws->stall_sec);
+}
+
+static int run_threads(int nthreads, const PrefixList *roots,
+                       const char *out_path)
+{
+    n_workers = nthreads;
+    workers = calloc(n_workers, sizeof *workers);
+
+    char fname[512];
+    for (int i = 0; i < n_workers; ++i) {
+        Worker *w = &workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->id  = i;
+        w->rng = 2463534242u + 97u*i;
+        w->solver = iq_solver_create(iq_tables(), &opts, solution, &w->out);
+        iq_solver_set_split(w->solver, offer_task, w, SPLIT_DEPTH);
+        if (count_only) continue;
+        snprintf(fname, sizeof(fname), "%s.t%d", out_path, i);
+        w->out.fp = fopen(fname, binary_out ? "wb" : "w");
+        if (!w->out.fp) { perror(fname); return 1; }
+        setvbuf(w->out.fp, NULL, _IOFBF, OUT_BUF_SIZE);
+    }
+
+    if (roots) {
+        for (int i = 0; i < roots->cnt; ++i) {
+            Task t;
+            prefix_state(&roots->items[i], roots->depth,
+                         &t.occ, &t.used_mask, t.occ_piece);
+            push_task(&workers[i % n_workers], &t);
+        }
+    } else {
+        Task root = { 0ULL, 0, {0} };
+        push_task(&workers[0], &root);
+    }
+
+    struct timespec t0,t1,t2; clock_gettime(CLOCK_MONOTONIC,&t0);
+
+    for (int i = 0; i < n_workers; ++i)
+        pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]);
+    for (int i = 0; i < n_workers; ++i)
+        pthread_join(workers[i].tid, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+
+    uint64_t tasks = 0, steals = 0, total = 0, canon = 0, n_nodes = 0;
+    WriterStats ws = {0};
+    for (int i = 0; i < n_workers; ++i) {
+        Worker *w = &workers[i];
+        if (w->out.fp) fclose(w->out.fp);
+        printf("[Thread %d] solutions: %" PRIu64 ", tasks: %" PRIu64
+               ", steals: %" PRIu64 "\n",
+               i, w->out.sol_written, w->tasks_run, w->steals);
+        tasks += w->tasks_run;
+        steals += w->steals;
+        total += w->out.sol_written;
+        canon += w->out.canon_found;
+        n_nodes += w->nodes;
+        ws.bytes     += w->ws.bytes;
+        ws.writes    += w->ws.writes;
+        ws.stalls    += w->ws.stalls;
+        ws.stall_sec += w->ws.stall_sec;
+    }
+
+    if (!count_only) {
+        FILE *out = fopen(out_path, binary_out ? "wb" : "w");
+        if(!out){ perror(out_path); return 1; }
+        total = merge_thread_files(out, out_path);
+        fclose(out);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&t2);
+    double sec = (t1.tv_sec - t0.tv_sec) +
+                 (t1.tv_nsec - t0.tv_nsec)/1e9;
+    double merge_sec = (t2.tv_sec - t1.tv_sec) +
+                       (t2.tv_nsec - t1.tv_nsec)/1e9;
+
+    printf("\n=== RESULTS ===\n"
+           "Threads: %d (tasks: %" PRIu64 ", steals: %" PRIu64 ")\n"
+           "Canonical solutions found: %" PRIu64 "\n"
+           "Total solutions %s: %" PRIu64 "\n"
+           "Search nodes: %" PRIu64 "\n"
+           "Elapsed: %.2f s (merge: %.2f s)\n",
+           n_workers, tasks, steals, canon,
+           count_only ? "counted" : "written", total, n_nodes,
+           sec, merge_sec);
+    if (async_out && !count_only)
+        print_writer_stats(&ws);
+
+    for (int i = 0; i < n_workers; ++i) {
+        pthread_mutex_destroy(&workers[i].lock);
+        collect_stats(workers[i].solver);
+        iq_solver_free(workers[i].solver);
+        free(workers[i].q);
+    }
+    free(workers);
+    return 0;
+}
+
+static int run_partition(int shards, int depth, int probes,
+                         const char *path)
+{
+    struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC,&t0);
+
+    PrefixList pl = {0};
+    enum_prefixes(&pl, depth);
+    partition_prefixes(&pl, shards, probes);
+    if (write_worklist(path, &pl) != 0) { free_prefixes(&pl); return 1; }
+
+    double *load = calloc(shards, sizeof *load);
+    int    *cnt  = calloc(shards, sizeof *cnt);
+    double  total = 0, max_load = 0;
+    for (int i = 0; i < pl.cnt; ++i) {
+        load[pl.items[i].shard] += pl.items[i].est;
+        ++cnt[pl.items[i].shard];
+        total += pl.items[i].est;
+    }
+    for (int s = 0; s < shards; ++s) {
+        printf("[Shard %d] prefixes: %d, estimated nodes: %.3g\n",
+               s, cnt[s], load[s]);
+        if (load[s] > max_load) max_load = load[s];
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    double sec = (t1.tv_sec - t0.tv_sec) +
+                 (t1.tv_nsec - t0.tv_nsec)/1e9;
+
+    printf("\n=== PARTITION ===\n"
+           "Prefixes at depth %d: %d\n"
+           "Estimated nodes: %.3g (max/mean shard: %.3f)\n"
+           "Work list written to %s in %.2f s\n",
+           depth, pl.cnt, total, max_load * shards / total, path, sec);
+
+    free(load);
+    free(cnt);
+    free_prefixes(&pl);
+    return 0;
+}
+
+/* ---------- rank table ---------- */
+
+static const PrefixList *rank_list;
+static uint64_t         *rank_boards;
+static atomic_int        rank_next;
+
+static int count_boards(void *ctx, const uint64_t occ_piece[NUM_PIECES])
+{
+    *(uint64_t *)ctx += solution_multiplicity(occ_piece);
+    return 0;
+}
+
+static void *rank_main(void *arg)
+{
+    (void)arg;
+    uint64_t boards;
+    IqSolver *solver = iq_solver_create(iq_tables(), &opts, count_boards, &boards);
+    int i;
+    while ((i = atomic_fetch_add(&rank_next, 1)) < rank_list->cnt) {
+        boards = 0;
+        iq_solve_prefix(solver, rank_list->items[i].idx, rank_list->depth);
+        rank_boards[i] = boards;
+    }
+    collect_stats(solver);
+    iq_solver_free(solver);
+    return NULL;
+}
+
+/* Counts the boards below every prefix, in any order and on any number
+   of threads; the table itself follows the single-threaded output. */
+static int run_rank_table(int depth, int nthreads, const char *path)
+{
+    if (opts.branch_constrained) {
+        fprintf(stderr, "--rank-table numbers the boards of lowest-cell branching\n");
+        return 1;
     }
+    struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC,&t0);
 
-    dump_solution(B);
+    PrefixList pl = {0};
+    enum_prefixes(&pl, depth);
+    rank_list = &pl;
+    rank_boards = calloc(pl.cnt ? pl.cnt : 1, sizeof *rank_boards);
+    atomic_store(&rank_next, 0);
 
-    if (memcmp(B, B_h_mir, BOARD_CELLS) != 0) {
-        dump_solution(B_h_mir);
+    if (nthreads > 1) {
+        pthread_t *tid = malloc(nthreads * sizeof *tid);
+        for (int i = 0; i < nthreads; ++i)
+            pthread_create(&tid[i], NULL, rank_main, NULL);
+        for (int i = 0; i < nthreads; ++i)
+            pthread_join(tid[i], NULL);
+        free(tid);
+    } else {
+        rank_main(NULL);
     }
 
-    if (memcmp(B, B_v_mir, BOARD_CELLS) != 0 && memcmp(B_h_mir, B_v_mir, BOARD_CELLS) != 0) {
-        dump_solution(B_v_mir);
+    int rc = rank_table_write(path, &pl, rank_boards);
+    uint64_t total = 0;
+    int live = 0;
+    for (int i = 0; i < pl.cnt; ++i) {
+        total += rank_boards[i];
+        live  += rank_boards[i] > 0;
     }
 
-    if (memcmp(B, B_180_rot, BOARD_CELLS) != 0 && memcmp(B_h_mir, B_180_rot, BOARD_CELLS) != 0 &&
-        memcmp(B_v_mir, B_180_rot, BOARD_CELLS) != 0) {
-        dump_solution(B_180_rot);
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    double sec = (t1.tv_sec - t0.tv_sec) +
+                 (t1.tv_nsec - t0.tv_nsec)/1e9;
+    if (rc == 0)
+        printf("\n=== RANK TABLE ===\n"
+               "Prefixes at depth %d: %d (%d with solutions)\n"
+               "Solutions (all symmetries): %" PRIu64 "\n"
+               "Table written to %s in %.2f s\n",
+               depth, pl.cnt, live, total, path, sec);
+
+    free(rank_boards);
+    free_prefixes(&pl);
+    return rc ? 1 : 0;
+}
+
+static int run_memo(const PrefixList *roots, size_t budget, MemoPolicy pol)
+{
+    if (memo_init(budget, pol) != 0) {
+        fprintf(stderr, "Cannot allocate %zu MB transposition table\n",
+                budget >> 20);
+        return 1;
+    }
+
+    struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC,&t0);
+
+    uint64_t canon = 0, total = 0;
+    uint64_t occ_piece[NUM_PIECES] = {0};
+    int n = roots ? roots->cnt : 1;
+    for (int i = 0; i < n; ++i) {
+        uint64_t occ = 0;
+        uint32_t used_mask = 0;
+        int depth = 0;
+        if (roots) {
+            prefix_state(&roots->items[i], roots->depth,
+                         &occ, &used_mask, occ_piece);
+            depth = roots->depth;
+        }
+        uint64_t c = memo_count(occ, used_mask, depth);
+        canon += c;
+        total += memo_total(occ_piece, occ, used_mask, c);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    double sec = (t1.tv_sec - t0.tv_sec) +
+                 (t1.tv_nsec - t0.tv_nsec)/1e9;
+
+    MemoStats st;
+    memo_stats(&st);
+    printf("\n=== RESULTS ===\n"
+           "Canonical solutions found: %" PRIu64 "\n"
+           "Total solutions counted: %" PRIu64 "\n"
+           "Elapsed: %.2f s\n"
+           "Table: %.1f MB, %" PRIu64 "/%" PRIu64 " slots used, "
+           "%" PRIu64 " evictions\n"
+           "Lookups: %" PRIu64 ", hits: %" PRIu64 " (%.1f%%)\n",
+           canon, total, sec, st.bytes / 1048576.0, st.used, st.entries,
+           st.evictions, st.lookups, st.hits,
+           st.lookups ? 100.0 * st.hits / st.lookups : 0.0);
+
+    memo_free();
+    return 0;
+}
+
+static const ChallengeList *chal_list;
+static ChallengeResult     *chal_results;
+static atomic_int           chal_next;
+
+static void solve_challenge(IqSolver *solver, ChallengeCtx *cc,
+                            const Challenge *c, ChallengeResult *r)
+{
+    uint64_t n0 = iq_solver_nodes(solver);
+    cc->r = r;
+    for (int s = 0; s < 4; ++s) {
+        uint64_t occ, occ_piece[NUM_PIECES];
+        uint32_t used_mask;
+        if (!challenge_state(c, s, &occ, &used_mask, occ_piece)) continue;
+        cc->sym = s;
+        iq_solve(solver, occ, used_mask, occ_piece);
+        if (solve_mode == SOLVE_FIRST && r->count) break;
     }
+    r->nodes = iq_solver_nodes(solver) - n0;
 }
 
-static void dfs(uint64_t occ, uint32_t used_mask,
-                uint64_t occ_piece[NUM_PIECES], int depth)
+/* Queries are independent; each thread takes the next unsolved one. */
+static void *challenge_main(void *arg)
 {
-    if (SHOULD_PRUNE(occ)) return;
+    (void)arg;
+    ChallengeCtx cc = {0};
+    IqSolver *solver = iq_solver_create(iq_tables(), &opts,
+                                        challenge_solution, &cc);
+    int i;
+    while ((i = atomic_fetch_add(&chal_next, 1)) < chal_list->cnt)
+        solve_challenge(solver, &cc, &chal_list->items[i], &chal_results[i]);
+    collect_stats(solver);
+    iq_solver_free(solver);
+    return NULL;
+}
+
+static int run_challenges(const char *path, int nthreads, const char *out_path)
+{
+    ChallengeList cl = {0};
+    if (read_challenges(path, &cl) != 0) return 1;
+    printf("Challenges %s: %d boards\n", path, cl.cnt);
+
+    chal_list = &cl;
+    chal_results = calloc(cl.cnt ? cl.cnt : 1, sizeof *chal_results);
+    atomic_store(&chal_next, 0);
 
-    if (used_mask == (1u<<NUM_PIECES)-1) {
-        emit(occ_piece);
-        return;
+    struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC,&t0);
+
+    if (nthreads > 1) {
+        pthread_t *tid = malloc(nthreads * sizeof *tid);
+        for (int i = 0; i < nthreads; ++i)
+            pthread_create(&tid[i], NULL, challenge_main, NULL);
+        for (int i = 0; i < nthreads; ++i)
+            pthread_join(tid[i], NULL);
+        free(tid);
+    } else {
+        challenge_main(NULL);
     }
 
-    int first = __builtin_ctzll(~occ & FULL_MASK);
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    double sec = (t1.tv_sec - t0.tv_sec) +
+                 (t1.tv_nsec - t0.tv_nsec)/1e9;
 
-    int *lst = placements_by_cell[first];
-    int  cnt = placements_by_cell_cnt[first];
+    FILE *out = fopen(out_path, "w");
+    if (!out) { perror(out_path); return 1; }
 
-    for (int k=0;k<cnt;++k) {
-        int idx  = lst[k];
-        int pid  = idx_pid[idx];
+    uint64_t total = 0, n_nodes = 0;
+    int solved = 0;
+    for (int i = 0; i < cl.cnt; ++i) {
+        ChallengeResult *r = &chal_results[i];
+        total   += r->count;
+        n_nodes += r->nodes;
+        solved  += r->count > 0;
+        if (solve_mode == SOLVE_FIRST)
+            fprintf(out, "Challenge %d: %s\n", i+1,
+                    r->count ? "solved" : "no solution");
+        else
+            fprintf(out, "Challenge %d: %" PRIu64 " solutions\n", i+1, r->count);
+        Output o = { out, NULL, 0, 0 };
+        for (size_t k = 0; k < r->n; ++k)
+            dump_solution(&o, r->boards + k*BOARD_CELLS);
+        free(r->boards);
+    }
+    fclose(out);
 
-        if (used_mask & (1u<<pid)) continue;
+    printf("\n=== RESULTS ===\n"
+           "Threads: %d\n"
+           "Challenges: %d (solved: %d, no solution: %d)\n"
+           "Solutions %s: %" PRIu64 "\n"
+           "Search nodes: %" PRIu64 "\n"
+           "Elapsed: %.3f s (%.0f queries/s)\n"
+           "Results written to %s\n",
+           nthreads, cl.cnt, solved, cl.cnt - solved,
+           solve_mode == SOLVE_COUNT ? "counted" : "found", total, n_nodes,
+           sec, sec > 0 ? cl.cnt / sec : 0.0, out_path);
 
-        uint64_t pmask = place[idx].mask;
-        if (pmask & occ) continue;
+    free(chal_results);
+    free_challenges(&cl);
+    return 0;
+}
+
+/* ---------- puzzles from a definition file ---------- */
+
+typedef struct {
+    const Puzzle *pz;
+    FILE         *fp;
+    uint64_t      sol_written;
+    uint64_t      canon_found;
+} PuzzleOutput;
 
-        occ_piece[pid] = pmask;
-        dfs(occ|pmask, used_mask|(1u<<pid), occ_piece, depth+1);
-        occ_piece[pid] = 0;
+static int puzzle_solution(void *ctx, const int place_of[])
+{
+    PuzzleOutput *o = ctx;
+    int sym[PUZZLE_MAX_SYMS];
+    int n = puzzle_variants(o->pz, place_of, sym);
+    if (canonical_out && o->fp) n = 1;
+    ++o->canon_found;
+    if (!o->fp) { o->sol_written += n; return 0; }
+
+    char board[PUZZLE_MAX_CELLS];
+    for (int i = 0; i < n; ++i) {
+        puzzle_board(o->pz, place_of, sym[i], board);
+        dump_board(o->fp, ++o->sol_written, board, o->pz->w, o->pz->h);
     }
+    return 0;
 }
-static void build_tables(void)
+
+static int run_puzzle(const Puzzle *pz, const PuzzleOptions *popt,
+                      const char *out_path)
 {
-    FULL_MASK = (BOARD_CELLS==64)?~0ULL:((1ULL<<BOARD_CELLS)-1);
+    int kernel = popt->kernel ? popt->kernel : puzzle_kernel(pz);
+    if (kernel < puzzle_kernel(pz)) {
+        fprintf(stderr, "A %d-cell board needs the 128-bit kernel\n", pz->cells);
+        return 1;
+    }
+    printf("Puzzle: %dx%d board, %d open cells, %d pieces, %d placements, "
+           "%d symmetries, %d-bit kernel\n", pz->w, pz->h, pz->open_cnt,
+           pz->pieces, pz->place_cnt, pz->syms, kernel);
+
+    PuzzleOutput out = { pz, NULL, 0, 0 };
+    if (!count_only) {
+        out.fp = fopen(out_path, "w");
+        if (!out.fp) { perror(out_path); return 1; }
+    }
 
-    for (int r=0;r<BOARD_H;++r)
-        for (int c=0;c<BOARD_W;++c) {
-            int bit = r*BOARD_W + c;
-            uint64_t N = 0;
-            if (r)               N |= 1ULL<<(bit-BOARD_W);
-            if (r+1<BOARD_H)     N |= 1ULL<<(bit+BOARD_W);
-            if (c)               N |= 1ULL<<(bit-1);
-            if (c+1<BOARD_W)     N |= 1ULL<<(bit+1);
-            neighbor_masks[bit]=N;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t nodes = 0;
+    puzzle_solve(pz, popt, puzzle_solution, &out, &nodes);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec)/1e9;
+
+    printf("\n=== RESULTS ===\n"
+           "Canonical solutions found: %" PRIu64 "\n"
+           "Total solutions %s: %" PRIu64 "\n"
+           "Search nodes: %" PRIu64 "\n"
+           "Elapsed: %.2f s\n", out.canon_found,
+           count_only ? "counted" : "written", out.sol_written, nodes, sec);
+    if (out.fp) fclose(out.fp);
+    return 0;
+}
+
+/* ---------- checkpointed runs ---------- */
+
+/* Records everything up to the last finished prefix. The output reaches
+   the disk first, so a checkpoint never covers bytes that were lost. */
+static int save_checkpoint(Checkpoint *ck, const char *path, Output *o,
+                           uint64_t nodes)
+{
+    if (o->fp && ckpt_sync(o->fp, &ck->out_bytes) != 0) return -1;
+    ck->canon   = o->canon_found;
+    ck->written = o->sol_written;
+    ck->nodes   = nodes;
+    return ckpt_save(ck, path);
+}
+
+/* Searches the prefixes in order and saves <out>.ckpt after a finished
+   prefix once ckpt_every seconds have passed since the last save. With
+   --resume it first picks up the checkpoint of an earlier, identical run:
+   the output is cut back to what that checkpoint covers and the finished
+   prefixes are skipped. */
+static int run_checkpointed(const PrefixList *roots, const char *out_path)
+{
+    char ckpt_path[512];
+    snprintf(ckpt_path, sizeof ckpt_path, "%s.ckpt", out_path);
+
+    Checkpoint ck;
+    ckpt_init(&ck, roots, binary_out | canonical_out << 1 | count_only << 2);
+    int loaded = resume ? ckpt_load(&ck, ckpt_path) : 1;
+    if (loaded < 0) { ckpt_free(&ck); return 1; }
+
+    Output out = {0};
+    if (loaded == 0) {
+        printf("Resuming from %s: %d of %d prefixes done, %" PRIu64
+               " solutions\n", ckpt_path, ckpt_done_count(&ck), ck.cnt,
+               ck.written);
+        out.canon_found = ck.canon;
+        out.sol_written = ck.written;
+        if (!count_only && !(out.fp = ckpt_reopen(out_path, ck.out_bytes))) {
+            ckpt_free(&ck);
+            return 1;
         }
+    } else {
+        if (resume) printf("No checkpoint %s, starting from scratch\n", ckpt_path);
+        if (!count_only) {
+            out.fp = fopen(out_path, binary_out ? "wb" : "w");
+            if (!out.fp) { perror(out_path); ckpt_free(&ck); return 1; }
+            if (binary_out) solfile_write_header(out.fp, 0);
+        }
+    }
 
-    idx_pid = malloc(place_cnt);
-    for (int pid=0; pid<NUM_PIECES; ++pid)
-        for (int i=p_first[pid]; i<p_first[pid]+p_count[pid]; ++i)
-            idx_pid[i]=pid;
+    IqSolver *solver = iq_solver_create(iq_tables(), &opts, solution, &out);
+    uint64_t nodes_before = ck.nodes;
+    struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC,&t0);
+    double last = 0;
+    int saves = 0;
+
+    for (int i = 0; i < roots->cnt; ++i) {
+        if (ck.done[i]) continue;
+        iq_solve_prefix(solver, roots->items[i].idx, roots->depth);
+        ck.done[i] = 1;
 
-    memset(placements_by_cell_cnt,0,sizeof(placements_by_cell_cnt));
-    for (int idx=0; idx<place_cnt; ++idx) {
-        uint64_t m = place[idx].mask;
-        while (m){ int b=__builtin_ctzll(m);
-                   ++placements_by_cell_cnt[b]; m&=m-1; }
+        clock_gettime(CLOCK_MONOTONIC,&t1);
+        double t = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec)/1e9;
+        if (t - last < ckpt_every || i == roots->cnt - 1) continue;
+        if (save_checkpoint(&ck, ckpt_path, &out,
+                            nodes_before + iq_solver_nodes(solver)) != 0)
+            fprintf(stderr, "Warning: checkpoint %s not saved\n", ckpt_path);
+        else
+            ++saves;
+        last = t;
     }
-    for (int b=0;b<BOARD_CELLS;++b)
-        placements_by_cell[b]=malloc(placements_by_cell_cnt[b]*sizeof(int)),
-        placements_by_cell_cnt[b]=0;
 
-    for (int idx=0; idx<place_cnt; ++idx) {
-        uint64_t m = place[idx].mask;
-        while (m){ int b=__builtin_ctzll(m);
-                   placements_by_cell[b][ placements_by_cell_cnt[b]++ ] = idx;
-                   m&=m-1; }
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    double sec = (t1.tv_sec - t0.tv_sec) +
+                 (t1.tv_nsec - t0.tv_nsec)/1e9;
+    uint64_t nodes = nodes_before + iq_solver_nodes(solver);
+    collect_stats(solver);
+    iq_solver_free(solver);
+
+    printf("\n=== RESULTS ===\n"
+           "Canonical solutions found: %" PRIu64 "\n"
+           "Total solutions %s: %" PRIu64 "\n"
+           "Search nodes: %" PRIu64 "\n"
+           "Elapsed: %.2f s (%d checkpoints)\n", out.canon_found,
+           count_only ? "counted" : "written", out.sol_written, nodes, sec,
+           saves);
+
+    int rc = 0;
+    if (out.fp) {
+        if (binary_out) solfile_set_count(out.fp, out.sol_written);
+        if (fclose(out.fp) != 0) { perror(out_path); rc = 1; }
     }
+    /* the run is complete, a later --resume starts over */
+    if (rc == 0) remove(ckpt_path);
+    ckpt_free(&ck);
+    return rc;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-t <threads>] [-o <file>] [--binary] [--async] [--count-only]\n"
+            "          [--canonical]\n"
+            "          [--prune-regions] [--branch lowest|constrained]\n"
+            "          [--engine dfs|dlx]\n"
+            "          [--memo [--memo-mb <n>] [--memo-policy always|shallow]]\n"
+            "          [--worklist <file> [--shard <n>]]\n"
+            "          [--checkpoint <seconds>] [--resume] [--depth <1-%d>]\n"
+            "          [--challenges <file|-> [--solve first|all|count]]\n"
+            "          [--partition <shards> [--depth <1-%d>] [--probes <n>]]\n"
+            "          [--rank-table [--depth <1-%d>]]\n"
+            "          [--puzzle <file> [--kernel 64|128]]\n",
+            prog, MAX_PREFIX_DEPTH, MAX_PREFIX_DEPTH, MAX_PREFIX_DEPTH);
 }
-int main(void)
+
+int main(int argc, char **argv)
 {
     setvbuf(stdout,NULL,_IONBF,0);
+#ifdef IQ_STATS
+    atexit(write_stats);
+#endif
+
+    int nthreads = 1;
+    int shards = 0, depth = 3, probes = 100, shard = -1;
+    int rank_table = 0, depth_set = 0;
+    const char *worklist = NULL;
+    const char *challenges = NULL;
+    const char *out_path = NULL;
+    const char *puzzle = NULL;
+    PuzzleOptions popt = {0};
+    int memo = 0, use_dlx = 0;
+    size_t memo_mb = 64;
+    MemoPolicy memo_policy = MEMO_ALWAYS;
+    for (int i = 1; i < argc; ++i) {
+        if ((!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads")) &&
+            i+1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--branch") && i+1 < argc) {
+            ++i;
+            if (!strcmp(argv[i], "constrained"))  opts.branch_constrained = 1;
+            else if (!strcmp(argv[i], "lowest"))  opts.branch_constrained = 0;
+            else { usage(argv[0]); return 1; }
+        } else if (!strcmp(argv[i], "--engine") && i+1 < argc) {
+            ++i;
+            if (!strcmp(argv[i], "dlx"))      use_dlx = 1;
+            else if (!strcmp(argv[i], "dfs")) use_dlx = 0;
+            else { usage(argv[0]); return 1; }
+        } else if (!strcmp(argv[i], "--memo")) {
+            memo = 1;
+        } else if (!strcmp(argv[i], "--memo-mb") && i+1 < argc) {
+            memo_mb = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--memo-policy") && i+1 < argc) {
+            ++i;
+            if (!strcmp(argv[i], "always"))       memo_policy = MEMO_ALWAYS;
+            else if (!strcmp(argv[i], "shallow")) memo_policy = MEMO_SHALLOW;
+            else { usage(argv[0]); return 1; }
+        } else if (!strcmp(argv[i], "--async")) {
+            async_out = 1;
+        } else if (!strcmp(argv[i], "--binary")) {
+            binary_out = 1;
+        } else if (!strcmp(argv[i], "--canonical")) {
+            canonical_out = 1;
+        } else if (!strcmp(argv[i], "--count-only")) {
+            count_only = 1;
+        } else if (!strcmp(argv[i], "--prune-regions")) {
+            opts.prune_regions = 1;
+        } else if (!strcmp(argv[i], "-o") && i+1 < argc) {
+            out_path = argv[++i];
+        } else if (!strcmp(argv[i], "--partition") && i+1 < argc) {
+            shards = atoi(argv[++i]);
+            if (shards < 1) { usage(argv[0]); return 1; }
+        } else if (!strcmp(argv[i], "--depth") && i+1 < argc) {
+            depth = atoi(argv[++i]);
+            depth_set = 1;
+        } else if (!strcmp(argv[i], "--rank-table")) {
+            rank_table = 1;
+        } else if (!strcmp(argv[i], "--probes") && i+1 < argc) {
+            probes = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--worklist") && i+1 < argc) {
+            worklist = argv[++i];
+        } else if (!strcmp(argv[i], "--shard") && i+1 < argc) {
+            shard = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--checkpoint") && i+1 < argc) {
+            ckpt_every = atoi(argv[++i]);
+            if (ckpt_every < 1) { usage(argv[0]); return 1; }
+        } else if (!strcmp(argv[i], "--resume")) {
+            resume = 1;
+#ifdef IQ_STATS
+        } else if (!strcmp(argv[i], "--stats") && i+1 < argc) {
+            stats_path = argv[++i];
+#endif
+        } else if (!strcmp(argv[i], "--challenges") && i+1 < argc) {
+            challenges = argv[++i];
+        } else if (!strcmp(argv[i], "--puzzle") && i+1 < argc) {
+            puzzle = argv[++i];
+        } else if (!strcmp(argv[i], "--kernel") && i+1 < argc) {
+            popt.kernel = atoi(argv[++i]);
+            if (popt.kernel != 64 && popt.kernel != 128) { usage(argv[0]); return 1; }
+        } else if (!strcmp(argv[i], "--solve") && i+1 < argc) {
+            ++i;
+            if (!strcmp(argv[i], "first"))      solve_mode = SOLVE_FIRST;
+            else if (!strcmp(argv[i], "all"))   solve_mode = SOLVE_ALL;
+            else if (!strcmp(argv[i], "count")) solve_mode = SOLVE_COUNT;
+            else { usage(argv[0]); return 1; }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    /* rank tables go one level deeper: four pieces leave subtrees small
+       enough to search on every lookup */
+    if (rank_table && !depth_set) depth = 4;
+    if (nthreads < 1 || depth < 1 || depth > MAX_PREFIX_DEPTH || probes < 1) {
+        usage(argv[0]);
+        return 1;
+    }
 
-    init_all();
-    build_tables();
+    iq_tables();
 
-    fp_out = fopen("solutions.txt","w");
-    if(!fp_out){ perror("solutions.txt"); return 1; }
+    /* the work list estimator follows the same pruning and branching */
+    prune_regions = opts.prune_regions;
+    branch_constrained = opts.branch_constrained;
+
+    if (puzzle) {
+        Puzzle pz;
+        if (puzzle_load(puzzle, &pz) != 0) return 1;
+        if (puzzle_is_builtin(&pz) && !popt.kernel) {
+            printf("Puzzle %s is the compiled-in puzzle\n", puzzle);
+            puzzle_free(&pz);
+        } else {
+            if (shards || challenges || worklist || memo || use_dlx ||
+                binary_out || async_out || ckpt_every || resume) {
+                fprintf(stderr, "--puzzle only takes -o, --count-only, --canonical, "
+                                "--prune-regions, --branch and --kernel\n");
+                return 1;
+            }
+            if (nthreads > 1) fprintf(stderr, "--puzzle runs on one thread\n");
+            popt.prune_regions      = opts.prune_regions;
+            popt.branch_constrained = opts.branch_constrained;
+            int rc = run_puzzle(&pz, &popt, out_path ? out_path : "solutions.txt");
+            puzzle_free(&pz);
+            iq_tables_free();
+            return rc;
+        }
+    }
+
+    if (shards)
+        return run_partition(shards, depth, probes,
+                             out_path ? out_path : "worklist.txt");
+
+    if (rank_table)
+        return run_rank_table(depth, nthreads,
+                              out_path ? out_path : "solutions.rank");
+
+    if (challenges)
+        return run_challenges(challenges, nthreads,
+                              out_path ? out_path : "challenge_solutions.txt");
+
+    if (!out_path) out_path = binary_out ? "solutions.bin" : "solutions.txt";
+
+    PrefixList roots = {0};
+    if (worklist) {
+        if (read_worklist(worklist, shard, &roots) != 0) return 1;
+        printf("Work list %s: %d prefixes at depth %d\n",
+               worklist, roots.cnt, roots.depth);
+    }
+
+    if (resume && !ckpt_every) ckpt_every = 60;
+    if (ckpt_every) {
+        if (memo || use_dlx) {
+            fprintf(stderr, "--checkpoint and --resume need the dfs engine\n");
+            free_prefixes(&roots);
+            return 1;
+        }
+        if (nthreads > 1) fprintf(stderr, "--checkpoint runs on one thread\n");
+        if (async_out) fprintf(stderr, "--checkpoint writes synchronously\n");
+        async_out = 0;
+        if (!worklist) enum_prefixes(&roots, depth);
+        int rc = run_checkpointed(&roots, out_path);
+        free_prefixes(&roots);
+        iq_tables_free();
+        return rc;
+    }
+
+    if (memo) {
+        int rc = run_memo(worklist ? &roots : NULL, memo_mb << 20, memo_policy);
+        free_prefixes(&roots);
+        return rc;
+    }
+
+    if (use_dlx && nthreads > 1) {
+        fprintf(stderr, "The dlx engine runs on one thread\n");
+        nthreads = 1;
+    }
+
+    if (nthreads > 1) {
+        int rc = run_threads(nthreads, worklist ? &roots : NULL, out_path);
+        free_prefixes(&roots);
+        return rc;
+    }
+
+    Output out = {0};
+    if (!count_only) {
+        out.fp = fopen(out_path, binary_out ? "wb" : "w");
+        if(!out.fp){ perror(out_path); return 1; }
+        if (binary_out) solfile_write_header(out.fp, 0);
+        if (async_out) {
+            fflush(out.fp);
+            out.writer = writer_open(fileno(out.fp), binary_out, !canonical_out);
+            if (!out.writer) { fprintf(stderr, "Cannot start writer thread\n"); return 1; }
+        }
+    }
 
     struct timespec t0,t1; clock_gettime(CLOCK_MONOTONIC,&t0);
 
-    uint64_t occ_piece[NUM_PIECES]={0};
-    dfs(0ULL,0,occ_piece,0);
+    uint64_t nodes;
+    if (use_dlx) {
+        Dlx *d = dlx_create();
+        if (!d) { fprintf(stderr, "Cannot build the DLX matrix\n"); return 1; }
+        if (worklist) {
+            for (int i = 0; i < roots.cnt; ++i)
+                dlx_solve(d, roots.items[i].idx, roots.depth, solution, &out);
+        } else {
+            dlx_solve(d, NULL, 0, solution, &out);
+        }
+        nodes = dlx_nodes(d);
+        dlx_free(d);
+    } else {
+        IqSolver *solver = iq_solver_create(iq_tables(), &opts, solution, &out);
+        if (worklist) {
+            for (int i = 0; i < roots.cnt; ++i)
+                iq_solve_prefix(solver, roots.items[i].idx, roots.depth);
+        } else {
+            iq_solve(solver, 0ULL, 0, NULL);
+        }
+        nodes = iq_solver_nodes(solver);
+        collect_stats(solver);
+        iq_solver_free(solver);
+    }
+    free_prefixes(&roots);
+
+    WriterStats ws = {0};
+    if (out.writer) {
+        if (writer_close(out.writer, &ws) != 0) perror(out_path);
+        out.sol_written = ws.solutions;
+        out.writer = NULL;
+    }
 
     clock_gettime(CLOCK_MONOTONIC,&t1);
     double sec = (t1.tv_sec - t0.tv_sec) +
                  (t1.tv_nsec - t0.tv_nsec)/1e9;
 
     printf("\n=== RESULTS ===\n"
-           "Total solutions written: %" PRIu64 "\n"
-           "Elapsed: %.2f s\n", sol_written, sec);
+           "Canonical solutions found: %" PRIu64 "\n"
+           "Total solutions %s: %" PRIu64 "\n"
+           "Search nodes: %" PRIu64 "\n"
+           "Elapsed: %.2f s\n", out.canon_found,
+           count_only ? "counted" : "written", out.sol_written, nodes, sec);
+    if (async_out && !count_only)
+        print_writer_stats(&ws);
 
-    fclose(fp_out);
+    if (out.fp) {
+        if (binary_out) solfile_set_count(out.fp, out.sol_written);
+        fclose(out.fp);
+    }
+    iq_tables_free();
     return 0;
 }
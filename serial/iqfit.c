@@ -0,0 +1,525 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "iqfit.h"
+
+#define ALL_PIECES ((1u<<NUM_PIECES)-1)
+
+/* The handle iq_tables() returns; the search itself reads the init.h
+   globals. */
+struct IqTables {
+    const Placement *place;
+    int              place_cnt;
+};
+
+/* One node of the iterative search: its position and a cursor over its
+   children. With lowest-cell branching the cursor walks the anchor groups
+   of the pieces in todo, a FIT_LANES block at a time (fit holds the lanes
+   of block k not yet returned); with constrained branching it walks
+   placements_by_cell[cell] from next to end. */
+typedef struct {
+    uint64_t occ;
+    uint32_t used_mask;
+    uint32_t todo;
+    int      cell;
+    int      pid;                       /* piece of the current group */
+    int      k, next, end;
+    unsigned fit;
+} IqFrame;
+
+struct IqSolver {
+    const IqTables *t;
+    IqOptions       opt;
+    IqSolutionFn    fn;
+    void           *ctx;
+    IqSplitFn       split;
+    void           *split_ctx;
+    int             split_depth;
+    int             stop;
+    uint64_t        nodes;
+    uint64_t        found;
+    uint64_t        occ_piece[NUM_PIECES];
+    int             sp;                 /* frames in use */
+    int             root;               /* the start node is yet to visit */
+    uint64_t        root_occ;
+    uint32_t        root_used;
+    IqFrame         stack[NUM_PIECES];  /* a complete board pushes none */
+#ifdef IQ_STATS
+    IqStats         stats;
+#endif
+};
+
+static IqTables tables;
+
+const IqTables *iq_tables(void)
+{
+    if (!tables.place) {
+        init_all();
+        build_tables();
+        tables.place     = place;
+        tables.place_cnt = place_cnt;
+    }
+    return &tables;
+}
+
+void iq_tables_free(void)
+{
+    if (!tables.place) return;
+    free_tables();
+    memset(&tables, 0, sizeof tables);
+}
+
+int iq_place_count(const IqTables *t)              { return t->place_cnt; }
+uint64_t iq_place_mask(const IqTables *t, int idx) { return t->place[idx].mask; }
+int iq_place_piece(const IqTables *t, int idx)     { return t->place[idx].piece; }
+
+IqSolver *iq_solver_create(const IqTables *t, const IqOptions *opt,
+                           IqSolutionFn fn, void *ctx)
+{
+    IqSolver *s = calloc(1, sizeof *s);
+    if (!s) return NULL;
+    s->t   = t;
+    s->fn  = fn;
+    s->ctx = ctx;
+    if (opt) s->opt = *opt;
+    return s;
+}
+
+void iq_solver_free(IqSolver *s)
+{
+    free(s);
+}
+
+void iq_solver_set_split(IqSolver *s, IqSplitFn fn, void *ctx, int split_depth)
+{
+    s->split       = fn;
+    s->split_ctx   = ctx;
+    s->split_depth = split_depth;
+}
+
+uint64_t iq_solver_nodes(const IqSolver *s)
+{
+    return s->nodes;
+}
+
+#ifdef IQ_STATS
+
+#define STAT(x) (x)
+#define DEPTH(u) __builtin_popcount(u)
+
+static inline int prune_counted(IqSolver *s, uint64_t occ, uint32_t used_mask)
+{
+    if (orphan_1x1(occ)) {
+        ++s->stats.orphan[DEPTH(used_mask)];
+        return 1;
+    }
+    if (s->opt.prune_regions && region_infeasible(occ, used_mask)) {
+        ++s->stats.region[DEPTH(used_mask)];
+        return 1;
+    }
+    return 0;
+}
+
+#define PRUNE(s, m, u) prune_counted(s, m, u)
+
+void iq_solver_stats(const IqSolver *s, IqStats *sum)
+{
+    iq_stats_add(sum, &s->stats);
+}
+
+void iq_stats_add(IqStats *sum, const IqStats *st)
+{
+    uint64_t *d = (uint64_t *)sum;
+    const uint64_t *a = (const uint64_t *)st;
+    for (size_t i = 0; i < sizeof *st / sizeof *a; ++i) d[i] += a[i];
+}
+
+static void json_array(FILE *f, const char *name, const uint64_t *v, int n,
+                       const char *sep)
+{
+    fprintf(f, "    \"%s\": [", name);
+    for (int i = 0; i < n; ++i)
+        fprintf(f, "%s%" PRIu64, i ? ", " : "", v[i]);
+    fprintf(f, "]%s\n", sep);
+}
+
+int iq_stats_write(const char *path, const IqStats *st)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); return -1; }
+
+    uint64_t nodes = 0, children = 0, branched = 0;
+    for (int d = 0; d <= NUM_PIECES; ++d) nodes += st->nodes[d];
+    for (int c = 0; c < BOARD_CELLS; ++c) {
+        branched += st->branch_nodes[c];
+        children += st->branch_children[c];
+    }
+
+    fprintf(f, "{\n  \"nodes\": %" PRIu64 ",\n", nodes);
+    fprintf(f, "  \"mean_branching\": %.4f,\n",
+            branched ? (double)children / branched : 0.0);
+    fprintf(f, "  \"by_depth\": {\n");
+    json_array(f, "nodes",        st->nodes,        NUM_PIECES + 1, ",");
+    json_array(f, "orphan",       st->orphan,       NUM_PIECES + 1, ",");
+    json_array(f, "region",       st->region,       NUM_PIECES + 1, ",");
+    json_array(f, "skip_used",    st->skip_used,    NUM_PIECES + 1, ",");
+    json_array(f, "skip_overlap", st->skip_overlap, NUM_PIECES + 1, "");
+    fprintf(f, "  },\n  \"by_cell\": {\n");
+    json_array(f, "branch_nodes",    st->branch_nodes,    BOARD_CELLS, ",");
+    json_array(f, "branch_children", st->branch_children, BOARD_CELLS, "");
+    fprintf(f, "  }\n}\n");
+
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+#else
+
+#define STAT(x) ((void)0)
+#define PRUNE(s, m, u) \
+    (orphan_1x1(m) || ((s)->opt.prune_regions && region_infeasible(m, u)))
+
+#endif
+
+static void report(IqSolver *s)
+{
+    ++s->found;
+    if (s->fn && s->fn(s->ctx, s->occ_piece)) s->stop = 1;
+}
+
+static void search(IqSolver *s, uint64_t occ, uint32_t used_mask)
+{
+    ++s->nodes;
+    STAT(++s->stats.nodes[DEPTH(used_mask)]);
+    if (s->stop || PRUNE(s, occ, used_mask)) return;
+
+    if (used_mask == ALL_PIECES) {
+        report(s);
+        return;
+    }
+
+    uint64_t *occ_piece = s->occ_piece;
+
+    if (s->opt.branch_constrained) {
+        int cell = most_constrained_cell(occ, used_mask);
+        STAT(++s->stats.branch_nodes[cell]);
+
+        const int *lst = placements_by_cell[cell];
+        int  cnt = placements_by_cell_cnt[cell];
+
+        for (int k=0;k<cnt;++k) {
+            int idx  = lst[k];
+            int pid  = idx_pid[idx];
+
+            if (used_mask & (1u<<pid)) {
+                STAT(++s->stats.skip_used[DEPTH(used_mask)]);
+                continue;
+            }
+
+            uint64_t pmask = place[idx].mask;
+            if (pmask & occ) {
+                STAT(++s->stats.skip_overlap[DEPTH(used_mask)]);
+                continue;
+            }
+
+            STAT(++s->stats.branch_children[cell]);
+            occ_piece[pid] = pmask;
+            search(s, occ|pmask, used_mask|(1u<<pid));
+            occ_piece[pid] = 0;
+        }
+        return;
+    }
+
+    /* every cell below the lowest empty one is filled, so only placements
+       anchored there can cover it */
+    int first = __builtin_ctzll(~occ & FULL_MASK);
+
+#ifdef IQ_STATS
+    /* the anchor groups of placed pieces are never looked at */
+    ++s->stats.branch_nodes[first];
+    for (uint32_t u = used_mask; u; u &= u-1) {
+        int g = first*NUM_PIECES + __builtin_ctzll(u);
+        s->stats.skip_used[DEPTH(used_mask)] += anchor_start[g+1] - anchor_start[g];
+    }
+#endif
+
+    for (uint32_t todo = ~used_mask & ALL_PIECES; todo; todo &= todo-1) {
+        int pid = __builtin_ctzll(todo);
+        int g   = first*NUM_PIECES + pid;
+        int end = anchor_start[g+1];
+
+        for (int k=anchor_start[g]; k<end; k+=FIT_LANES) {
+            unsigned fit = fit_lanes(&anchor_mask[k], occ) & lane_mask(end-k);
+            STAT(s->stats.skip_overlap[DEPTH(used_mask)] +=
+                 __builtin_popcount(lane_mask(end-k) & ~fit));
+            STAT(s->stats.branch_children[first] += __builtin_popcount(fit));
+            for (; fit; fit &= fit-1) {
+                uint64_t pmask = anchor_mask[k + __builtin_ctzll(fit)];
+                occ_piece[pid] = pmask;
+                search(s, occ|pmask, used_mask|(1u<<pid));
+            }
+        }
+        occ_piece[pid] = 0;
+    }
+}
+
+static void search_split(IqSolver *s, uint64_t occ, uint32_t used_mask,
+                         int depth);
+
+/* Offers the child of placing pmask to the split callback and searches it
+   if the callback leaves it. */
+static void split_child(IqSolver *s, uint64_t occ, uint32_t used_mask,
+                        int depth, int pid, uint64_t pmask)
+{
+    s->occ_piece[pid] = pmask;
+    if (!s->split(s->split_ctx, occ|pmask, used_mask|(1u<<pid), s->occ_piece)) {
+        if (depth+1 < s->split_depth)
+            search_split(s, occ|pmask, used_mask|(1u<<pid), depth+1);
+        else
+            search(s, occ|pmask, used_mask|(1u<<pid));
+    }
+}
+
+/* Same search, with the same children in the same order, but every child
+   is first offered to the split callback. */
+static void search_split(IqSolver *s, uint64_t occ, uint32_t used_mask,
+                         int depth)
+{
+    ++s->nodes;
+    STAT(++s->stats.nodes[depth]);
+    if (s->stop || PRUNE(s, occ, used_mask)) return;
+
+    if (used_mask == ALL_PIECES) {
+        report(s);
+        return;
+    }
+
+    uint64_t *occ_piece = s->occ_piece;
+
+    if (s->opt.branch_constrained) {
+        int cell = most_constrained_cell(occ, used_mask);
+        STAT(++s->stats.branch_nodes[cell]);
+
+        const int *lst = placements_by_cell[cell];
+        int  cnt = placements_by_cell_cnt[cell];
+
+        for (int k=0;k<cnt && !s->stop;++k) {
+            int idx  = lst[k];
+            int pid  = idx_pid[idx];
+
+            if (used_mask & (1u<<pid)) {
+                STAT(++s->stats.skip_used[depth]);
+                continue;
+            }
+
+            uint64_t pmask = place[idx].mask;
+            if (pmask & occ) {
+                STAT(++s->stats.skip_overlap[depth]);
+                continue;
+            }
+
+            STAT(++s->stats.branch_children[cell]);
+            split_child(s, occ, used_mask, depth, pid, pmask);
+            occ_piece[pid] = 0;
+        }
+        return;
+    }
+
+    int first = __builtin_ctzll(~occ & FULL_MASK);
+
+#ifdef IQ_STATS
+    ++s->stats.branch_nodes[first];
+    for (uint32_t u = used_mask; u; u &= u-1) {
+        int g = first*NUM_PIECES + __builtin_ctzll(u);
+        s->stats.skip_used[depth] += anchor_start[g+1] - anchor_start[g];
+    }
+#endif
+
+    for (uint32_t todo = ~used_mask & ALL_PIECES; todo && !s->stop; todo &= todo-1) {
+        int pid = __builtin_ctzll(todo);
+        int g   = first*NUM_PIECES + pid;
+        int end = anchor_start[g+1];
+
+        for (int k=anchor_start[g]; k<end && !s->stop; k+=FIT_LANES) {
+            unsigned fit = fit_lanes(&anchor_mask[k], occ) & lane_mask(end-k);
+            STAT(s->stats.skip_overlap[depth] +=
+                 __builtin_popcount(lane_mask(end-k) & ~fit));
+            STAT(s->stats.branch_children[first] += __builtin_popcount(fit));
+            for (; fit && !s->stop; fit &= fit-1)
+                split_child(s, occ, used_mask, depth, pid,
+                            anchor_mask[k + __builtin_ctzll(fit)]);
+        }
+        occ_piece[pid] = 0;
+    }
+}
+
+/* The position after placements idx[0..depth-1]; returns its used_mask. */
+static uint32_t prefix_position(const IqSolver *s, const uint16_t *idx, int depth,
+                                uint64_t *occ, uint64_t occ_piece[NUM_PIECES])
+{
+    uint32_t used_mask = 0;
+    *occ = 0;
+    memset(occ_piece, 0, NUM_PIECES * sizeof *occ_piece);
+    for (int d = 0; d < depth; ++d) {
+        const Placement *p = &s->t->place[idx[d]];
+        occ_piece[p->piece] = p->mask;
+        *occ |= p->mask;
+        used_mask |= 1u << p->piece;
+    }
+    return used_mask;
+}
+
+/* ---------- iterative search ----------
+   The same search as search(), in the same order and with the same node
+   count, but with its recursion kept in s->stack, so that it can stop
+   after any solution and carry on from there on the next call. */
+
+/* What search() does on entering a node: returns 1 at a solution, or
+   pushes a frame for the children. */
+static int iter_enter(IqSolver *s, uint64_t occ, uint32_t used_mask)
+{
+    ++s->nodes;
+    STAT(++s->stats.nodes[DEPTH(used_mask)]);
+    if (PRUNE(s, occ, used_mask)) return 0;
+
+    if (used_mask == ALL_PIECES) {
+        ++s->found;
+        return 1;
+    }
+
+    IqFrame *f = &s->stack[s->sp++];
+    f->occ       = occ;
+    f->used_mask = used_mask;
+    f->fit       = 0;
+    if (s->opt.branch_constrained) {
+        f->cell = most_constrained_cell(occ, used_mask);
+        f->next = 0;
+        f->end  = placements_by_cell_cnt[f->cell];
+    } else {
+        f->cell = __builtin_ctzll(~occ & FULL_MASK);
+        f->todo = ~used_mask & ALL_PIECES;
+        f->pid  = -1;
+        f->next = f->end = 0;
+#ifdef IQ_STATS
+        for (uint32_t u = used_mask; u; u &= u-1) {
+            int g = f->cell*NUM_PIECES + __builtin_ctzll(u);
+            s->stats.skip_used[DEPTH(used_mask)] += anchor_start[g+1] - anchor_start[g];
+        }
+#endif
+    }
+    STAT(++s->stats.branch_nodes[f->cell]);
+    return 0;
+}
+
+/* Moves the cursor of f to its next child. Returns 0 when there is none. */
+static int iter_advance(IqSolver *s, IqFrame *f, uint64_t *pmask, int *pid)
+{
+    if (s->opt.branch_constrained) {
+        const int *lst = placements_by_cell[f->cell];
+        while (f->next < f->end) {
+            int idx = lst[f->next++];
+            int p   = idx_pid[idx];
+            if (f->used_mask & (1u<<p)) {
+                STAT(++s->stats.skip_used[DEPTH(f->used_mask)]);
+                continue;
+            }
+            if (place[idx].mask & f->occ) {
+                STAT(++s->stats.skip_overlap[DEPTH(f->used_mask)]);
+                continue;
+            }
+            STAT(++s->stats.branch_children[f->cell]);
+            *pmask = place[idx].mask;
+            *pid   = p;
+            return 1;
+        }
+        return 0;
+    }
+
+    for (;;) {
+        if (f->fit) {
+            *pmask = anchor_mask[f->k + __builtin_ctzll(f->fit)];
+            *pid   = f->pid;
+            f->fit &= f->fit-1;
+            return 1;
+        }
+        if (f->next < f->end) {
+            f->k    = f->next;
+            f->next += FIT_LANES;
+            f->fit  = fit_lanes(&anchor_mask[f->k], f->occ) & lane_mask(f->end - f->k);
+            STAT(s->stats.skip_overlap[DEPTH(f->used_mask)] +=
+                 __builtin_popcount(lane_mask(f->end - f->k) & ~f->fit));
+            STAT(s->stats.branch_children[f->cell] += __builtin_popcount(f->fit));
+            continue;
+        }
+        if (!f->todo) return 0;
+        f->pid  = __builtin_ctzll(f->todo);
+        f->todo &= f->todo-1;
+        int g   = f->cell*NUM_PIECES + f->pid;
+        f->next = anchor_start[g];
+        f->end  = anchor_start[g+1];
+    }
+}
+
+void iq_solver_start(IqSolver *s, uint64_t occ, uint32_t used_mask,
+                     const uint64_t occ_piece[NUM_PIECES])
+{
+    for (int pid = 0; pid < NUM_PIECES; ++pid)
+        s->occ_piece[pid] = occ_piece && (used_mask & (1u<<pid)) ? occ_piece[pid] : 0;
+    s->sp        = 0;
+    s->root      = 1;
+    s->root_occ  = occ;
+    s->root_used = used_mask;
+}
+
+void iq_solver_start_prefix(IqSolver *s, const uint16_t *idx, int depth)
+{
+    uint64_t occ, occ_piece[NUM_PIECES];
+    uint32_t used_mask = prefix_position(s, idx, depth, &occ, occ_piece);
+    iq_solver_start(s, occ, used_mask, occ_piece);
+}
+
+int iq_next_solution(IqSolver *s, uint64_t occ_piece[NUM_PIECES])
+{
+    int found = 0;
+    if (s->root) {
+        s->root = 0;
+        found = iter_enter(s, s->root_occ, s->root_used);
+    }
+    while (!found && s->sp > 0) {
+        IqFrame *f = &s->stack[s->sp-1];
+        uint64_t pmask;
+        int pid;
+        if (!iter_advance(s, f, &pmask, &pid)) {
+            --s->sp;
+            continue;
+        }
+        s->occ_piece[pid] = pmask;
+        found = iter_enter(s, f->occ|pmask, f->used_mask|(1u<<pid));
+    }
+    if (found && occ_piece)
+        memcpy(occ_piece, s->occ_piece, sizeof s->occ_piece);
+    return found;
+}
+
+uint64_t iq_solve(IqSolver *s, uint64_t occ, uint32_t used_mask,
+                  const uint64_t occ_piece[NUM_PIECES])
+{
+    for (int pid = 0; pid < NUM_PIECES; ++pid)
+        s->occ_piece[pid] = occ_piece && (used_mask & (1u<<pid)) ? occ_piece[pid] : 0;
+
+    uint64_t found = s->found;
+    int depth = __builtin_popcountll(used_mask);
+    s->stop = 0;
+    if (s->split && depth < s->split_depth)
+        search_split(s, occ, used_mask, depth);
+    else
+        search(s, occ, used_mask);
+    return s->found - found;
+}
+
+uint64_t iq_solve_prefix(IqSolver *s, const uint16_t *idx, int depth)
+{
+    uint64_t occ, occ_piece[NUM_PIECES];
+    uint32_t used_mask = prefix_position(s, idx, depth, &occ, occ_piece);
+    return iq_solve(s, occ, used_mask, occ_piece);
+}
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+#include "memo.h"
+
+#define ALL_PIECES ((1u<<NUM_PIECES)-1)
+#define BUCKET     4
+
+typedef struct {
+    uint64_t occ;
+    uint32_t count;     /* canonical solutions below; the puzzle has ~1.1M */
+    uint16_t used;
+    uint8_t  depth;
+    uint8_t  full;
+} MemoEntry;
+
+static MemoEntry *table;
+static uint64_t   bucket_mask;
+static MemoPolicy policy;
+static MemoStats  stats;
+
+static inline uint64_t hash_state(uint64_t occ, uint32_t used)
+{
+    uint64_t x = occ ^ ((uint64_t)used << 52) ^ ((uint64_t)used * 0x9E3779B97F4A7C15ULL);
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/* Column-major numbering (bit c*BOARD_H + r): filling the lowest empty
+   cell then sweeps the board column by column, so the boundary between
+   filled and empty cells spans a few 5-cell columns instead of several
+   11-cell rows and far more states recur. */
+#define T_FIRST_BITS (BOARD_BITS / ((1ULL<<BOARD_H)-1))
+#define T_LAST_BITS  (T_FIRST_BITS << (BOARD_H-1))
+
+static uint64_t *t_mask;
+static uint16_t *t_by_cell[BOARD_CELLS];
+static int       t_by_cell_cnt[BOARD_CELLS];
+
+static uint64_t transpose(uint64_t m)
+{
+    uint64_t t = 0;
+    for (; m; m &= m-1) {
+        int b = __builtin_ctzll(m);
+        t |= 1ULL << (b % BOARD_W * BOARD_H + b / BOARD_W);
+    }
+    return t;
+}
+
+static int build_transposed(void)
+{
+    t_mask = malloc(place_cnt * sizeof *t_mask);
+    if (!t_mask) return -1;
+    for (int i = 0; i < place_cnt; ++i) t_mask[i] = transpose(place[i].mask);
+
+    for (int cell = 0; cell < BOARD_CELLS; ++cell) {
+        t_by_cell[cell] = malloc(place_cnt * sizeof *t_by_cell[cell]);
+        if (!t_by_cell[cell]) return -1;
+        t_by_cell_cnt[cell] = 0;
+        for (int i = 0; i < place_cnt; ++i)
+            if (t_mask[i] >> cell & 1)
+                t_by_cell[cell][t_by_cell_cnt[cell]++] = (uint16_t)i;
+    }
+    return 0;
+}
+
+static inline int t_orphan(uint64_t occ)
+{
+    uint64_t e = ~occ & BOARD_BITS;
+    uint64_t n = ((e >> 1) & ~T_LAST_BITS) | ((e << 1) & ~T_FIRST_BITS)
+               | (e >> BOARD_H) | (e << BOARD_H);
+    return (e & ~n) != 0;
+}
+
+int memo_init(size_t budget_bytes, MemoPolicy pol)
+{
+    uint64_t buckets = 1;
+    while (2 * buckets * BUCKET * sizeof(MemoEntry) <= budget_bytes) buckets *= 2;
+
+    table = calloc(buckets * BUCKET, sizeof *table);
+    if (!table || build_transposed() != 0) { memo_free(); return -1; }
+    bucket_mask = buckets - 1;
+    policy = pol;
+    memset(&stats, 0, sizeof stats);
+    stats.entries = buckets * BUCKET;
+    stats.bytes   = buckets * BUCKET * sizeof *table;
+    return 0;
+}
+
+void memo_free(void)
+{
+    free(table);
+    table = NULL;
+    free(t_mask);
+    t_mask = NULL;
+    for (int cell = 0; cell < BOARD_CELLS; ++cell) {
+        free(t_by_cell[cell]);
+        t_by_cell[cell] = NULL;
+    }
+}
+
+void memo_stats(MemoStats *st)
+{
+    *st = stats;
+}
+
+static void store(MemoEntry *b, uint64_t occ, uint32_t used, int depth,
+                  uint64_t count)
+{
+    MemoEntry *victim = NULL;
+    for (int i = 0; i < BUCKET; ++i)
+        if (!b[i].full) { victim = &b[i]; ++stats.used; break; }
+
+    if (!victim) {
+        if (policy == MEMO_SHALLOW) {
+            victim = &b[0];
+            for (int i = 1; i < BUCKET; ++i)
+                if (b[i].depth > victim->depth) victim = &b[i];
+            if (victim->depth < depth) return;
+        } else {
+            /* slots are kept oldest-first */
+            memmove(&b[0], &b[1], (BUCKET-1) * sizeof *b);
+            victim = &b[BUCKET-1];
+        }
+        ++stats.evictions;
+    }
+
+    victim->occ   = occ;
+    victim->count = (uint32_t)count;
+    victim->used  = (uint16_t)used;
+    victim->depth = (uint8_t)depth;
+    victim->full  = 1;
+    ++stats.stores;
+}
+
+static uint64_t count_t(uint64_t occ, uint32_t used_mask, int depth)
+{
+    if (t_orphan(occ)) return 0;
+    if (used_mask == ALL_PIECES) return 1;
+
+    MemoEntry *b = &table[(hash_state(occ, used_mask) & bucket_mask) * BUCKET];
+    ++stats.lookups;
+    for (int i = 0; i < BUCKET; ++i)
+        if (b[i].full && b[i].occ == occ && b[i].used == used_mask) {
+            ++stats.hits;
+            return b[i].count;
+        }
+
+    int first = __builtin_ctzll(~occ & BOARD_BITS);
+
+    const uint16_t *lst = t_by_cell[first];
+    int cnt = t_by_cell_cnt[first];
+
+    uint64_t sum = 0;
+    for (int k=0;k<cnt;++k) {
+        int idx = lst[k];
+        int pid = idx_pid[idx];
+        if (used_mask & (1u<<pid)) continue;
+
+        uint64_t pmask = t_mask[idx];
+        if (pmask & occ) continue;
+
+        sum += count_t(occ|pmask, used_mask|(1u<<pid), depth+1);
+    }
+
+    store(b, occ, used_mask, depth, sum);
+    return sum;
+}
+
+/* Canonical solutions below (occ, used_mask): the same set dfs() finds,
+   searched in column-major cell order. */
+uint64_t memo_count(uint64_t occ, uint32_t used_mask, int depth)
+{
+    return count_t(transpose(occ), used_mask, depth);
+}
+
+static int invariant(uint64_t m, int syms)
+{
+    for (int s = 1; s <= 3; ++s)
+        if ((syms >> (s-1) & 1) && mask_transform(m, s) != m) return 0;
+    return 1;
+}
+
+/* Canonical solutions below (occ, used_mask) that every symmetry in syms
+   maps onto themselves: only self-symmetric placements can appear. */
+static uint64_t count_fixed(uint64_t occ, uint32_t used_mask, int syms)
+{
+    if (SHOULD_PRUNE(occ, used_mask)) return 0;
+    if (used_mask == ALL_PIECES) return 1;
+
+    int first = __builtin_ctzll(~occ & FULL_MASK);
+
+    uint64_t sum = 0;
+    for (int k=0;k<placements_by_cell_cnt[first];++k) {
+        int idx = placements_by_cell[first][k];
+        int pid = idx_pid[idx];
+        if (used_mask & (1u<<pid)) continue;
+
+        uint64_t pmask = place[idx].mask;
+        if ((pmask & occ) || !invariant(pmask, syms)) continue;
+
+        sum += count_fixed(occ|pmask, used_mask|(1u<<pid), syms);
+    }
+    return sum;
+}
+
+/* Solutions of all symmetries below a node, given its canonical count.
+   With F_s the canonical solutions fixed by symmetry s and c those fixed by
+   all of them, b = F_h + F_v + F_r - 3c have a stabiliser of size 2 and
+   contribute 2 boards, c contribute 1 and the rest contribute 4. */
+uint64_t memo_total(const uint64_t occ_piece[NUM_PIECES], uint64_t occ,
+                    uint32_t used_mask, uint64_t canonical)
+{
+    uint64_t f[8] = {0};
+    for (int syms = 1; syms <= 7; syms <<= 1) {
+        int ok = 1;
+        for (int pid = 0; pid < NUM_PIECES; ++pid)
+            if (used_mask & (1u<<pid)) ok &= invariant(occ_piece[pid], syms);
+        f[syms] = ok ? count_fixed(occ, used_mask, syms) : 0;
+    }
+
+    int ok = 1;
+    for (int pid = 0; pid < NUM_PIECES; ++pid)
+        if (used_mask & (1u<<pid)) ok &= invariant(occ_piece[pid], 7);
+    uint64_t c = ok ? count_fixed(occ, used_mask, 7) : 0;
+    uint64_t b = f[1] + f[2] + f[4] - 3*c;
+
+    return 4*canonical - 2*b - 3*c;
+}
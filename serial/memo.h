@@ -0,0 +1,30 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "init.h"
+
+/* Memoised counting engine. Below a node, the number of solutions depends
+   only on (occ, used_mask), so subtree counts are cached in a fixed-size
+   transposition table of 4-entry buckets (one cache line each). */
+
+typedef enum {
+    MEMO_ALWAYS,    /* a new entry replaces the oldest slot of its bucket */
+    MEMO_SHALLOW    /* keep the shallowest (largest) subtrees, evict the deepest */
+} MemoPolicy;
+
+typedef struct {
+    uint64_t lookups, hits, stores, evictions;
+    uint64_t entries, used;     /* capacity and occupied slots */
+    size_t   bytes;
+} MemoStats;
+
+int      memo_init(size_t budget_bytes, MemoPolicy policy);
+void     memo_free(void);
+uint64_t memo_count(uint64_t occ, uint32_t used_mask, int depth);
+uint64_t memo_total(const uint64_t occ_piece[NUM_PIECES], uint64_t occ,
+                    uint32_t used_mask, uint64_t canonical);
+void     memo_stats(MemoStats *st);
+
+#endif
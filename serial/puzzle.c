@@ -0,0 +1,483 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "init.h"
+#include "puzzle.h"
+
+typedef struct { int r, c; } Cell;
+
+static int cmp_cell(const void *a, const void *b)
+{
+    const Cell *x = a, *y = b;
+    return x->r != y->r ? x->r - y->r : x->c - y->c;
+}
+
+static void mask_set(PuzzleMask *m, int cell)
+{
+    if (cell < 64) m->lo |= 1ULL << cell;
+    else           m->hi |= 1ULL << (cell - 64);
+}
+
+static int mask_test(const PuzzleMask *m, int cell)
+{
+    return cell < 64 ? (int)(m->lo >> cell) & 1 : (int)(m->hi >> (cell - 64)) & 1;
+}
+
+static int mask_eq(const PuzzleMask *a, const PuzzleMask *b)
+{
+    return a->lo == b->lo && a->hi == b->hi;
+}
+
+/* ---------- definition file ---------- */
+
+typedef struct {
+    Cell cell[PUZZLE_MAX_CELLS];
+    int  n;
+} Shape;
+
+typedef enum { IN_NONE, IN_BOARD, IN_PIECE } Block;
+
+static int parse_error(const char *path, int lineno, const char *msg, int arg)
+{
+    fprintf(stderr, "%s:%d: ", path, lineno);
+    fprintf(stderr, msg, arg);
+    fputc('\n', stderr);
+    return -1;
+}
+
+static int read_definition(const char *path, Puzzle *pz, Shape *shape)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) { perror(path); return -1; }
+
+    char  line[512];
+    int   lineno = 0, rc = 0, have_board = 0, rows = 0;
+    Block in = IN_NONE;
+
+    while (!rc && fgets(line, sizeof line, fp)) {
+        ++lineno;
+        size_t len = strlen(line);
+        while (len && (line[len-1] == '\n' || line[len-1] == '\r' ||
+                       line[len-1] == ' '  || line[len-1] == '\t'))
+            line[--len] = 0;
+
+        if (line[0] == '#') continue;
+        if (!len) { in = IN_NONE; continue; }
+
+        int w, h;
+        char name;
+        if (!strncmp(line, "board", 5) && (!line[5] || line[5] == ' ')) {
+            if (have_board) { rc = parse_error(path, lineno, "second board", 0); break; }
+            have_board = 1;
+            if (sscanf(line + 5, "%d %d", &w, &h) == 2) {
+                if (w < 1 || h < 1 || w*h > PUZZLE_MAX_CELLS) {
+                    rc = parse_error(path, lineno, "board larger than %d cells",
+                                     PUZZLE_MAX_CELLS);
+                    break;
+                }
+                pz->w = w;
+                pz->h = h;
+                memset(pz->open, 1, (size_t)w*h);
+                in = IN_NONE;
+            } else {
+                pz->w = pz->h = 0;
+                in = IN_BOARD;
+            }
+        } else if (!strncmp(line, "piece ", 6)) {
+            if (sscanf(line + 6, " %c", &name) != 1 || name == '.' || name == 'x') {
+                rc = parse_error(path, lineno, "bad piece name", 0);
+                break;
+            }
+            if (pz->pieces == PUZZLE_MAX_PIECES) {
+                rc = parse_error(path, lineno, "more than %d pieces",
+                                 PUZZLE_MAX_PIECES);
+                break;
+            }
+            for (int p = 0; p < pz->pieces; ++p)
+                if (pz->name[p] == name) {
+                    rc = parse_error(path, lineno, "piece %c defined twice", name);
+                    break;
+                }
+            pz->name[pz->pieces] = name;
+            shape[pz->pieces++].n = 0;
+            rows = 0;
+            in = IN_PIECE;
+        } else if (in == IN_BOARD) {
+            if (!pz->w) pz->w = (int)len;
+            if ((int)len != pz->w) {
+                rc = parse_error(path, lineno, "board row is not %d cells wide", pz->w);
+                break;
+            }
+            if ((pz->h + 1) * pz->w > PUZZLE_MAX_CELLS) {
+                rc = parse_error(path, lineno, "board larger than %d cells",
+                                 PUZZLE_MAX_CELLS);
+                break;
+            }
+            for (int c = 0; c < pz->w; ++c) {
+                if (line[c] != '.' && line[c] != 'x') {
+                    rc = parse_error(path, lineno, "board cell '%c' is not '.' or 'x'",
+                                     line[c]);
+                    break;
+                }
+                pz->open[pz->h * pz->w + c] = line[c] == '.';
+            }
+            ++pz->h;
+        } else if (in == IN_PIECE) {
+            Shape *s = &shape[pz->pieces - 1];
+            for (int c = 0; c < (int)len; ++c) {
+                if (line[c] == '.' || line[c] == ' ') continue;
+                if (s->n == PUZZLE_MAX_CELLS) {
+                    rc = parse_error(path, lineno, "piece larger than %d cells",
+                                     PUZZLE_MAX_CELLS);
+                    break;
+                }
+                s->cell[s->n++] = (Cell){ rows, c };
+            }
+            ++rows;
+        } else {
+            rc = parse_error(path, lineno, "expected 'board' or 'piece'", 0);
+        }
+    }
+    fclose(fp);
+    if (rc) return rc;
+
+    if (!pz->w || !pz->h)
+        return parse_error(path, lineno, "no board", 0);
+    if (!pz->pieces)
+        return parse_error(path, lineno, "no pieces", 0);
+
+    pz->cells = pz->w * pz->h;
+    pz->open_cnt = 0;
+    for (int c = 0; c < pz->cells; ++c) pz->open_cnt += pz->open[c];
+
+    int total = 0;
+    for (int p = 0; p < pz->pieces; ++p) {
+        if (!shape[p].n) {
+            fprintf(stderr, "%s: piece %c has no cells\n", path, pz->name[p]);
+            return -1;
+        }
+        pz->size[p] = shape[p].n;
+        total += shape[p].n;
+    }
+    if (total != pz->open_cnt) {
+        fprintf(stderr, "%s: the pieces cover %d cells, the board has %d\n",
+                path, total, pz->open_cnt);
+        return -1;
+    }
+    return 0;
+}
+
+/* ---------- placements and symmetries ---------- */
+
+/* Orientation t of a shape: bit 2 transposes, bits 0/1 mirror rows and
+   columns; the result is moved to the origin and sorted. */
+static void orient_shape(const Shape *src, int t, Shape *dst)
+{
+    int min_r = 1 << 30, min_c = 1 << 30;
+    dst->n = src->n;
+    for (int i = 0; i < src->n; ++i) {
+        int r = src->cell[i].r, c = src->cell[i].c;
+        if (t & 4) { int tmp = r; r = c; c = tmp; }
+        if (t & 1) r = -r;
+        if (t & 2) c = -c;
+        dst->cell[i] = (Cell){ r, c };
+        if (r < min_r) min_r = r;
+        if (c < min_c) min_c = c;
+    }
+    for (int i = 0; i < dst->n; ++i) {
+        dst->cell[i].r -= min_r;
+        dst->cell[i].c -= min_c;
+    }
+    qsort(dst->cell, dst->n, sizeof *dst->cell, cmp_cell);
+}
+
+static void add_placement(Puzzle *pz, int pid, const PuzzleMask *m, int *cap)
+{
+    if (pz->place_cnt == *cap) {
+        *cap = *cap ? 2 * *cap : 1024;
+        pz->mask  = realloc(pz->mask,  *cap * sizeof *pz->mask);
+        pz->piece = realloc(pz->piece, *cap * sizeof *pz->piece);
+    }
+    pz->mask[pz->place_cnt]  = *m;
+    pz->piece[pz->place_cnt] = (uint8_t)pid;
+    ++pz->place_cnt;
+}
+
+static void gen_placements(Puzzle *pz, const Shape *shape)
+{
+    int cap = 0;
+    for (int pid = 0; pid < pz->pieces; ++pid) {
+        pz->first[pid] = pz->place_cnt;
+        Shape seen[8];
+        int   n_seen = 0;
+
+        for (int t = 0; t < 8; ++t) {
+            Shape o;
+            orient_shape(&shape[pid], t, &o);
+            int dup = 0;
+            for (int k = 0; k < n_seen && !dup; ++k)
+                dup = !memcmp(seen[k].cell, o.cell, o.n * sizeof *o.cell);
+            if (dup) continue;
+            seen[n_seen++] = o;
+
+            int oh = 0, ow = 0;
+            for (int i = 0; i < o.n; ++i) {
+                if (o.cell[i].r >= oh) oh = o.cell[i].r + 1;
+                if (o.cell[i].c >= ow) ow = o.cell[i].c + 1;
+            }
+            for (int r = 0; r + oh <= pz->h; ++r)
+            for (int c = 0; c + ow <= pz->w; ++c) {
+                PuzzleMask m = {0, 0};
+                int fits = 1;
+                for (int i = 0; i < o.n && fits; ++i) {
+                    int cell = (r + o.cell[i].r) * pz->w + c + o.cell[i].c;
+                    fits = pz->open[cell];
+                    mask_set(&m, cell);
+                }
+                if (fits) add_placement(pz, pid, &m, &cap);
+            }
+        }
+    }
+    pz->first[pz->pieces] = pz->place_cnt;
+}
+
+/* The symmetries of the rectangle that keep the blocked cells blocked. */
+static void gen_symmetries(Puzzle *pz)
+{
+    int w = pz->w, h = pz->h;
+    int n_cand = w == h ? 8 : 4;
+    pz->syms = 0;
+    for (int s = 0; s < n_cand; ++s) {
+        uint8_t *perm = pz->perm[pz->syms];
+        int ok = 1;
+        for (int r = 0; r < h; ++r)
+        for (int c = 0; c < w; ++c) {
+            int r2, c2;
+            switch (s) {
+            case 0:  r2 = r;       c2 = c;       break;
+            case 1:  r2 = r;       c2 = w-1-c;   break;
+            case 2:  r2 = h-1-r;   c2 = c;       break;
+            case 3:  r2 = h-1-r;   c2 = w-1-c;   break;
+            case 4:  r2 = c;       c2 = w-1-r;   break;
+            case 5:  r2 = w-1-c;   c2 = r;       break;
+            case 6:  r2 = c;       c2 = r;       break;
+            default: r2 = w-1-c;   c2 = w-1-r;   break;
+            }
+            perm[r*w + c] = (uint8_t)(r2*w + c2);
+            ok &= pz->open[r*w + c] == pz->open[r2*w + c2];
+        }
+        if (ok) ++pz->syms;
+    }
+}
+
+static PuzzleMask mask_image(const Puzzle *pz, const PuzzleMask *m, int s)
+{
+    PuzzleMask out = {0, 0};
+    for (int c = 0; c < pz->cells; ++c)
+        if (mask_test(m, c)) mask_set(&out, pz->perm[s][c]);
+    return out;
+}
+
+static int find_placement(const Puzzle *pz, int pid, const PuzzleMask *m)
+{
+    for (int i = pz->first[pid]; i < pz->first[pid+1]; ++i)
+        if (mask_eq(&pz->mask[i], m)) return i;
+    return -1;
+}
+
+/* Keeps the first placement of each orbit of the piece that drops the
+   most placements. Any piece gives the same canonical solutions. */
+static void break_symmetry(Puzzle *pz)
+{
+    pz->skip = calloc(pz->place_cnt, 1);
+    pz->stab = calloc(pz->place_cnt, 1);
+    pz->brk_piece = -1;
+    if (pz->syms == 1) return;
+
+    int best = -1;
+    uint8_t *skip = malloc(pz->place_cnt);
+    for (int pid = 0; pid < pz->pieces; ++pid) {
+        int dropped = 0;
+        for (int i = pz->first[pid]; i < pz->first[pid+1]; ++i) {
+            skip[i] = 0;
+            for (int s = 1; s < pz->syms; ++s) {
+                PuzzleMask m = mask_image(pz, &pz->mask[i], s);
+                int j = find_placement(pz, pid, &m);
+                if (j < i) skip[i] = 1;
+                if (j == i) pz->stab[i] |= 1u << s;
+            }
+            dropped += skip[i];
+        }
+        if (dropped > best) {
+            best = dropped;
+            pz->brk_piece = pid;
+            memset(pz->skip, 0, pz->place_cnt);
+            memcpy(pz->skip + pz->first[pid], skip + pz->first[pid],
+                   pz->first[pid+1] - pz->first[pid]);
+        }
+    }
+    free(skip);
+}
+
+int puzzle_load(const char *path, Puzzle *pz)
+{
+    memset(pz, 0, sizeof *pz);
+    Shape *shape = malloc(PUZZLE_MAX_PIECES * sizeof *shape);
+    int rc = read_definition(path, pz, shape);
+    if (!rc) {
+        gen_placements(pz, shape);
+        for (int pid = 0; pid < pz->pieces && !rc; ++pid)
+            if (pz->first[pid] == pz->first[pid+1]) {
+                fprintf(stderr, "%s: piece %c does not fit on the board\n",
+                        path, pz->name[pid]);
+                rc = -1;
+            }
+    }
+    free(shape);
+    if (rc) { puzzle_free(pz); return rc; }
+
+    gen_symmetries(pz);
+    break_symmetry(pz);
+    return 0;
+}
+
+void puzzle_free(Puzzle *pz)
+{
+    free(pz->mask);
+    free(pz->piece);
+    free(pz->skip);
+    free(pz->stab);
+    memset(pz, 0, sizeof *pz);
+}
+
+int puzzle_kernel(const Puzzle *pz)
+{
+    return pz->cells <= 64 ? 64 : 128;
+}
+
+void puzzle_board(const Puzzle *pz, const int place_of[], int s, char *board)
+{
+    for (int c = 0; c < pz->cells; ++c)
+        board[c] = pz->open[c] ? '.' : 'x';
+    for (int pid = 0; pid < pz->pieces; ++pid) {
+        const PuzzleMask *m = &pz->mask[place_of[pid]];
+        for (int c = 0; c < pz->cells; ++c)
+            if (mask_test(m, c)) board[pz->perm[s][c]] = pz->name[pid];
+    }
+}
+
+int puzzle_variants(const Puzzle *pz, const int place_of[], int sym[])
+{
+    char b[PUZZLE_MAX_SYMS][PUZZLE_MAX_CELLS];
+    int n = 0;
+    for (int s = 0; s < pz->syms; ++s) {
+        puzzle_board(pz, place_of, s, b[n]);
+        int dup = 0;
+        for (int k = 0; k < n && !dup; ++k)
+            dup = !memcmp(b[k], b[n], pz->cells);
+        if (!dup) sym[n++] = s;
+    }
+    return n;
+}
+
+/* A solution whose breaking piece sits on a placement fixed by some syms
+   is found once per distinct image under those syms; only the smallest
+   board is kept. */
+static int puzzle_accept(const Puzzle *pz, const int place_of[])
+{
+    if (pz->brk_piece < 0) return 1;
+    unsigned stab = pz->stab[place_of[pz->brk_piece]];
+    if (!stab) return 1;
+
+    char b0[PUZZLE_MAX_CELLS], b[PUZZLE_MAX_CELLS];
+    puzzle_board(pz, place_of, 0, b0);
+    for (int s = 1; s < pz->syms; ++s) {
+        if (!(stab & (1u << s))) continue;
+        puzzle_board(pz, place_of, s, b);
+        if (memcmp(b, b0, pz->cells) < 0) return 0;
+    }
+    return 1;
+}
+
+/* Subset sums of the sizes of the pieces outside used, as a bitset of
+   PUZZLE_MAX_CELLS+1 bits. */
+static void piece_sums(const Puzzle *pz, uint32_t used, uint64_t sums[3])
+{
+    sums[0] = 1; sums[1] = sums[2] = 0;
+    for (int pid = 0; pid < pz->pieces; ++pid) {
+        if (used & (1u << pid)) continue;
+        int k = pz->size[pid];
+        uint64_t sh[3] = {0, 0, 0};
+        for (int i = 0; i < 3; ++i) {
+            int dst = i + k / 64, bit = k % 64;
+            if (dst < 3) sh[dst] |= sums[i] << bit;
+            if (bit && dst + 1 < 3) sh[dst+1] |= sums[i] >> (64 - bit);
+        }
+        for (int i = 0; i < 3; ++i) sums[i] |= sh[i];
+    }
+}
+
+static int sums_has(const uint64_t sums[3], int n)
+{
+    return (int)(sums[n / 64] >> (n % 64)) & 1;
+}
+
+/* ---------- kernels ---------- */
+
+static inline int ctz_64(uint64_t m) { return __builtin_ctzll(m); }
+static inline int pop_64(uint64_t m) { return __builtin_popcountll(m); }
+static inline uint64_t from_64(const PuzzleMask *m) { return m->lo; }
+
+typedef unsigned __int128 u128;
+
+static inline int ctz_128(u128 m)
+{
+    uint64_t lo = (uint64_t)m;
+    return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll((uint64_t)(m >> 64));
+}
+static inline int pop_128(u128 m)
+{
+    return __builtin_popcountll((uint64_t)m) + __builtin_popcountll((uint64_t)(m >> 64));
+}
+static inline u128 from_128(const PuzzleMask *m)
+{
+    return (u128)m->hi << 64 | m->lo;
+}
+
+#define KMASK    uint64_t
+#define K(name)  name##_64
+#define KFIT     1
+#include "puzzle_kernel.h"
+#undef KMASK
+#undef K
+#undef KFIT
+
+#define KMASK    u128
+#define K(name)  name##_128
+#define KFIT     0
+#include "puzzle_kernel.h"
+#undef KMASK
+#undef K
+#undef KFIT
+
+uint64_t puzzle_solve(const Puzzle *pz, const PuzzleOptions *opt,
+                      PuzzleSolutionFn fn, void *ctx, uint64_t *nodes)
+{
+    int kernel = opt->kernel ? opt->kernel : puzzle_kernel(pz);
+    if (kernel < puzzle_kernel(pz)) return UINT64_MAX;
+    return kernel == 64 ? solve_64(pz, opt, fn, ctx, nodes)
+                        : solve_128(pz, opt, fn, ctx, nodes);
+}
+
+int puzzle_is_builtin(const Puzzle *pz)
+{
+    if (pz->w != BOARD_W || pz->h != BOARD_H || pz->open_cnt != BOARD_CELLS ||
+        pz->pieces != NUM_PIECES)
+        return 0;
+    for (int pid = 0; pid < NUM_PIECES; ++pid) {
+        if (pz->name[pid] != piece_sym[pid]) return 0;
+        PuzzleMask m = { place[p_first[pid]].mask, 0 };
+        if (find_placement(pz, pid, &m) < 0) return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,93 @@
+#ifndef PUZZLE_H
+#define PUZZLE_H
+
+#include <stdint.h>
+
+/* Puzzles loaded at run time: a board of up to PUZZLE_MAX_CELLS cells and
+   up to PUZZLE_MAX_PIECES free pieces (every rotation and mirror image may
+   be used), read from a definition file:
+
+     # comment
+     board 11 5            a fully open 11x5 rectangle, or
+     board                 rows of '.' (open) and 'x' (blocked) cells
+     ........
+     ...xx...
+     piece Y               piece name, then its rows; any char but '.'
+     YYYY                  is a cell
+     .Y..
+
+   Cell r*w+c of the rectangle is bit r*w+c of a mask. A board of at most
+   64 cells is searched with uint64_t masks, a larger one with 128-bit
+   masks; both kernels are the same code (puzzle_kernel.h).
+
+   Only canonical solutions are reported: the placements of one piece are
+   limited to one per orbit of the board's symmetries, and the solutions
+   that placement cannot tell apart are kept only in their smallest form. */
+
+#define PUZZLE_MAX_CELLS  128
+#define PUZZLE_MAX_PIECES 32
+#define PUZZLE_MAX_SYMS   8
+
+typedef struct {
+    uint64_t lo, hi;                    /* cells 0-63, 64-127 */
+} PuzzleMask;
+
+typedef struct {
+    int        w, h, cells;             /* cells = w*h, blocked ones included */
+    uint8_t    open[PUZZLE_MAX_CELLS];
+    int        open_cnt;
+    int        pieces;
+    char       name[PUZZLE_MAX_PIECES];
+    int        size[PUZZLE_MAX_PIECES];
+
+    /* every placement, grouped by piece */
+    PuzzleMask *mask;
+    uint8_t    *piece;
+    int         place_cnt;
+    int         first[PUZZLE_MAX_PIECES + 1];
+
+    /* board symmetries as cell permutations; sym 0 is the identity */
+    int         syms;
+    uint8_t     perm[PUZZLE_MAX_SYMS][PUZZLE_MAX_CELLS];
+
+    /* symmetry breaking: the placements of piece brk_piece outside skip[]
+       represent their orbits; stab[i] has bit s set when sym s fixes
+       placement i */
+    int         brk_piece;
+    uint8_t    *skip;
+    uint8_t    *stab;
+} Puzzle;
+
+typedef struct {
+    int prune_regions;                  /* region sizes must be piece sums */
+    int branch_constrained;             /* most-constrained-cell branching */
+    int kernel;                         /* 64 or 128; 0 picks by board size */
+} PuzzleOptions;
+
+/* Called with the placement of every piece of a canonical solution. A
+   nonzero return stops the search. */
+typedef int (*PuzzleSolutionFn)(void *ctx, const int place_of[]);
+
+int  puzzle_load(const char *path, Puzzle *pz);
+void puzzle_free(Puzzle *pz);
+
+/* 64 or 128: the narrowest kernel whose masks hold the board. */
+int  puzzle_kernel(const Puzzle *pz);
+
+/* Enumerates the canonical solutions; returns how many were found, or
+   UINT64_MAX when opt asks for a kernel too narrow for the board. */
+uint64_t puzzle_solve(const Puzzle *pz, const PuzzleOptions *opt,
+                      PuzzleSolutionFn fn, void *ctx, uint64_t *nodes);
+
+/* The syms whose images of a solution are distinct, identity first. */
+int  puzzle_variants(const Puzzle *pz, const int place_of[], int sym[]);
+
+/* Image of a solution under sym s, one char per cell of the rectangle:
+   the piece names, and 'x' for blocked cells. */
+void puzzle_board(const Puzzle *pz, const int place_of[], int s, char *board);
+
+/* 1 when pz is the compiled-in puzzle: the same board and the same pieces
+   in the same order, so the init.h tables and kernel can solve it. */
+int  puzzle_is_builtin(const Puzzle *pz);
+
+#endif
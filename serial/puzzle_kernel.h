@@ -0,0 +1,216 @@
+/* Search kernel of puzzle.c for one mask width. puzzle.c includes this
+   file once per width with KMASK (the mask type), K() (name suffix) and
+   KFIT (1 when the masks are uint64_t and fit_lanes() applies) defined,
+   and ctz/pop/from helpers for the type in scope. */
+
+typedef struct {
+    const Puzzle    *pz;
+    PuzzleOptions    opt;
+    int              w, pieces, same_size;
+    uint32_t         all;
+    KMASK            open, col_first, col_last;
+
+    /* placements anchored at each cell (their lowest cell), grouped by
+       piece: group g = cell*pieces + piece holds amask/aidx[astart[g] ..
+       astart[g+1]-1]; amask is padded for fit_lanes() */
+    KMASK           *amask;
+    int             *aidx;
+    int             *astart;
+
+    /* placements covering each cell: cidx[cstart[c] .. cstart[c+1]-1] */
+    KMASK           *mask;
+    int             *cidx;
+    int             *cstart;
+
+    PuzzleSolutionFn fn;
+    void            *ctx;
+    int              stop;
+    uint64_t         nodes, found;
+    int              place_of[PUZZLE_MAX_PIECES];
+} K(State);
+
+static inline KMASK K(neighbours)(const K(State) *st, KMASK s)
+{
+    return ((s >> 1) & ~st->col_last)
+         | ((s << 1) & ~st->col_first)
+         |  (s >> st->w)
+         |  (s << st->w);
+}
+
+static inline int K(orphan)(const K(State) *st, KMASK occ)
+{
+    KMASK empty = ~occ & st->open;
+    return (empty & ~K(neighbours)(st, empty)) != 0;
+}
+
+static int K(region_infeasible)(const K(State) *st, KMASK occ, uint32_t used)
+{
+    KMASK empty = ~occ & st->open;
+    uint64_t sums[3];
+    if (!st->same_size) piece_sums(st->pz, used, sums);
+
+    while (empty) {
+        KMASK region = empty & (0 - empty);
+        for (;;) {
+            KMASK grown = (region | K(neighbours)(st, region)) & empty;
+            if (grown == region) break;
+            region = grown;
+        }
+        int n = K(pop)(region);
+        if (st->same_size ? n % st->same_size : !sums_has(sums, n)) return 1;
+        empty &= ~region;
+    }
+    return 0;
+}
+
+static inline int K(fit_count)(const K(State) *st, int cell, KMASK occ,
+                               uint32_t used, int limit)
+{
+    int n = 0;
+    for (int k = st->cstart[cell]; k < st->cstart[cell+1] && n < limit; ++k) {
+        int idx = st->cidx[k];
+        n += !((used >> st->pz->piece[idx]) & 1) && !(st->mask[idx] & occ);
+    }
+    return n;
+}
+
+/* As most_constrained_cell() in init.h. */
+static int K(constrained_cell)(const K(State) *st, KMASK occ, uint32_t used)
+{
+    KMASK e = ~occ & st->open;
+    KMASK a = (e >> 1) & ~st->col_last;
+    KMASK b = (e << 1) & ~st->col_first;
+    KMASK c =  e >> st->w;
+    KMASK d = (e << st->w) & st->open;
+    KMASK open3 = (a & b & (c|d)) | (c & d & (a|b));
+
+    int best   = K(ctz)(e);
+    int best_n = K(fit_count)(st, best, occ, used, 1 << 30);
+    KMASK m = e & ~open3;
+    m &= ~((KMASK)1 << best);
+    for (; m && best_n; m &= m-1) {
+        int cell = K(ctz)(m);
+        int n = K(fit_count)(st, cell, occ, used, best_n);
+        if (n < best_n) { best = cell; best_n = n; }
+    }
+    return best;
+}
+
+static void K(search)(K(State) *st, KMASK occ, uint32_t used)
+{
+    ++st->nodes;
+    if (st->stop || K(orphan)(st, occ) ||
+        (st->opt.prune_regions && K(region_infeasible)(st, occ, used)))
+        return;
+
+    if (used == st->all) {
+        if (!puzzle_accept(st->pz, st->place_of)) return;
+        ++st->found;
+        if (st->fn && st->fn(st->ctx, st->place_of)) st->stop = 1;
+        return;
+    }
+
+    if (st->opt.branch_constrained) {
+        int cell = K(constrained_cell)(st, occ, used);
+        for (int k = st->cstart[cell]; k < st->cstart[cell+1]; ++k) {
+            int idx = st->cidx[k];
+            int pid = st->pz->piece[idx];
+            if ((used >> pid) & 1 || (st->mask[idx] & occ)) continue;
+            st->place_of[pid] = idx;
+            K(search)(st, occ | st->mask[idx], used | 1u << pid);
+        }
+        return;
+    }
+
+    int first = K(ctz)(~occ & st->open);
+    for (uint32_t todo = ~used & st->all; todo; todo &= todo-1) {
+        int pid = __builtin_ctzll(todo);
+        int g   = first*st->pieces + pid;
+        int end = st->astart[g+1];
+#if KFIT
+        for (int k = st->astart[g]; k < end; k += FIT_LANES) {
+            unsigned fit = fit_lanes(&st->amask[k], occ) & lane_mask(end-k);
+            for (; fit; fit &= fit-1) {
+                int j = k + __builtin_ctzll(fit);
+                st->place_of[pid] = st->aidx[j];
+                K(search)(st, occ | st->amask[j], used | 1u << pid);
+            }
+        }
+#else
+        for (int k = st->astart[g]; k < end; ++k) {
+            if (st->amask[k] & occ) continue;
+            st->place_of[pid] = st->aidx[k];
+            K(search)(st, occ | st->amask[k], used | 1u << pid);
+        }
+#endif
+    }
+}
+
+static uint64_t K(solve)(const Puzzle *pz, const PuzzleOptions *opt,
+                         PuzzleSolutionFn fn, void *ctx, uint64_t *nodes)
+{
+    K(State) st;
+    memset(&st, 0, sizeof st);
+    st.pz     = pz;
+    st.opt    = *opt;
+    st.w      = pz->w;
+    st.pieces = pz->pieces;
+    st.all    = pz->pieces == 32 ? ~0u : (1u << pz->pieces) - 1;
+    st.fn     = fn;
+    st.ctx    = ctx;
+
+    st.same_size = pz->size[0];
+    for (int pid = 1; pid < pz->pieces; ++pid)
+        if (pz->size[pid] != st.same_size) st.same_size = 0;
+
+    for (int r = 0; r < pz->h; ++r) {
+        st.col_first |= (KMASK)1 << (r*pz->w);
+        st.col_last  |= (KMASK)1 << (r*pz->w + pz->w-1);
+    }
+    for (int c = 0; c < pz->cells; ++c)
+        if (pz->open[c]) st.open |= (KMASK)1 << c;
+
+    int n = pz->place_cnt, groups = pz->cells * pz->pieces;
+    st.mask   = malloc(n * sizeof *st.mask);
+    st.amask  = calloc(n + 8, sizeof *st.amask);
+    st.aidx   = calloc(n + 8, sizeof *st.aidx);
+    st.astart = calloc(groups + 1, sizeof *st.astart);
+    st.cstart = calloc(pz->cells + 1, sizeof *st.cstart);
+
+    int covered = 0;
+    for (int i = 0; i < n; ++i) {
+        st.mask[i] = K(from)(&pz->mask[i]);
+        if (pz->skip[i]) continue;
+        ++st.astart[K(ctz)(st.mask[i])*pz->pieces + pz->piece[i] + 1];
+        for (KMASK m = st.mask[i]; m; m &= m-1) ++st.cstart[K(ctz)(m) + 1];
+        covered += pz->size[pz->piece[i]];
+    }
+    for (int g = 0; g < groups; ++g) st.astart[g+1] += st.astart[g];
+    for (int c = 0; c < pz->cells; ++c) st.cstart[c+1] += st.cstart[c];
+
+    int *afill = malloc(groups * sizeof *afill);
+    int *cfill = malloc(pz->cells * sizeof *cfill);
+    memcpy(afill, st.astart, groups * sizeof *afill);
+    memcpy(cfill, st.cstart, pz->cells * sizeof *cfill);
+    st.cidx = malloc((covered + 1) * sizeof *st.cidx);
+    for (int i = 0; i < n; ++i) {
+        if (pz->skip[i]) continue;
+        int g = K(ctz)(st.mask[i])*pz->pieces + pz->piece[i];
+        st.amask[afill[g]] = st.mask[i];
+        st.aidx[afill[g]++] = i;
+        for (KMASK m = st.mask[i]; m; m &= m-1) st.cidx[cfill[K(ctz)(m)]++] = i;
+    }
+    free(afill);
+    free(cfill);
+
+    K(search)(&st, ~st.open, 0);
+
+    free(st.mask);
+    free(st.amask);
+    free(st.aidx);
+    free(st.astart);
+    free(st.cidx);
+    free(st.cstart);
+    if (nodes) *nodes = st.nodes;
+    return st.found;
+}
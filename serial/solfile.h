@@ -0,0 +1,48 @@
+#ifndef SOLFILE_H
+#define SOLFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Binary solution file:
+     SolFileHeader
+     uint64_t mask[place_cnt]      placement table the records index into
+     uint8_t  piece[place_cnt]     padded with zeros to a multiple of 8
+     records                       count * record_size bytes
+   A record is uint16_t[pieces + 1]: the placement index used for each
+   piece of the canonical solution, followed by the symmetry (SYM_*) that
+   maps it onto the stored solution. Fields are in host byte order
+   (little-endian on the x86-64 targets the solvers are built for). */
+
+#define SOLFILE_MAGIC   "IQFB"
+#define SOLFILE_VERSION 1
+
+#define SYM_ID     0
+#define SYM_HFLIP  1
+#define SYM_VFLIP  2
+#define SYM_ROT180 3
+
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint8_t  board_w, board_h, pieces, record_size;
+    uint32_t place_cnt;
+    uint64_t count;
+    char     piece_sym[16];
+    uint64_t reserved;
+} SolFileHeader;
+
+static inline size_t solfile_data_offset(const SolFileHeader *h)
+{
+    return sizeof(SolFileHeader) + 8u * h->place_cnt +
+           ((h->place_cnt + 7u) & ~7u);
+}
+
+/* Bytes before the first record: the header and the placement table. */
+size_t solfile_header_size(void);
+/* Those bytes, for a file of count records, into buf. */
+void   solfile_header_image(void *buf, uint64_t count);
+int    solfile_write_header(FILE *f, uint64_t count);
+int    solfile_set_count(FILE *f, uint64_t count);
+
+#endif
@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "solindex.h"
+
+#define CHUNK_IDS   65536
+#define BITMAP_LEN  (CHUNK_IDS / 16)    /* uint16_t words of a bitmap chunk */
+
+static size_t pad8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+int solmap_open(const char *path, SolMap *sm)
+{
+    memset(sm, 0, sizeof *sm);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return -1; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SolFileHeader)) {
+        fprintf(stderr, "%s: not a solutions file\n", path);
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) { perror(path); return -1; }
+
+    const SolFileHeader *h = base;
+    if (memcmp(h->magic, SOLFILE_MAGIC, 4) != 0 || h->version != SOLFILE_VERSION ||
+        h->board_w != BOARD_W || h->board_h != BOARD_H ||
+        h->pieces != NUM_PIECES ||
+        h->record_size != (NUM_PIECES + 1) * sizeof(uint16_t) ||
+        solfile_data_offset(h) + h->count * h->record_size > (size_t)st.st_size) {
+        fprintf(stderr, "%s: not a solutions file for this board\n", path);
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    sm->h     = h;
+    sm->mask  = (const uint64_t *)((const char *)base + sizeof *h);
+    sm->piece = (const uint8_t *)(sm->mask + h->place_cnt);
+    sm->rec   = (const uint16_t *)((const char *)base + solfile_data_offset(h));
+    sm->map   = base;
+    sm->size  = st.st_size;
+    return 0;
+}
+
+void solmap_close(SolMap *sm)
+{
+    if (sm->map) munmap(sm->map, sm->size);
+    memset(sm, 0, sizeof *sm);
+}
+
+static const SolIndex *sort_ix;
+
+static int cmp_key_mask(const void *a, const void *b)
+{
+    uint64_t x = sort_ix->key_mask[*(const uint32_t *)a];
+    uint64_t y = sort_ix->key_mask[*(const uint32_t *)b];
+    return (x > y) - (x < y);
+}
+
+static void sort_keys(SolIndex *ix)
+{
+    ix->by_mask = malloc(ix->h.keys * sizeof *ix->by_mask);
+    for (uint32_t k = 0; k < ix->h.keys; ++k) ix->by_mask[k] = k;
+    sort_ix = ix;
+    qsort(ix->by_mask, ix->h.keys, sizeof *ix->by_mask, cmp_key_mask);
+}
+
+int solindex_key(const SolIndex *ix, uint64_t mask, int pid)
+{
+    int lo = 0, hi = (int)ix->h.keys - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        uint64_t m = ix->key_mask[ix->by_mask[mid]];
+        if (m == mask) {
+            /* distinct pieces have distinct shapes, so a mask has one key */
+            int k = ix->by_mask[mid];
+            return ix->key_piece[k] == pid ? k : -1;
+        }
+        if (m < mask) lo = mid + 1; else hi = mid - 1;
+    }
+    return -1;
+}
+
+/* Keys of the file's placements under every symmetry: key_of[4*i + s]. */
+static uint32_t *build_keys(const SolMap *sm, uint64_t **mask_out,
+                            uint8_t **piece_out, uint32_t *keys_out)
+{
+    uint32_t n = sm->h->place_cnt, cap = 4 * n, keys = 0;
+    uint64_t *mask  = malloc(cap * sizeof *mask);
+    uint8_t  *piece = malloc(cap);
+    uint32_t *key_of = malloc(cap * sizeof *key_of);
+
+    /* open addressing on the mask; slots hold key+1 */
+    uint32_t hsize = 1;
+    while (hsize < 2 * cap) hsize <<= 1;
+    uint32_t *slot = calloc(hsize, sizeof *slot);
+
+    for (int s = 0; s < 4; ++s)
+        for (uint32_t i = 0; i < n; ++i) {
+            uint64_t m = mask_transform(sm->mask[i], s);
+            uint32_t h = (uint32_t)((m * 0x9E3779B97F4A7C15ULL) >> 32) & (hsize-1);
+            while (slot[h] && mask[slot[h]-1] != m) h = (h+1) & (hsize-1);
+            if (!slot[h]) {
+                mask[keys]  = m;
+                piece[keys] = sm->piece[i];
+                slot[h] = ++keys;
+            }
+            key_of[4*i + s] = slot[h] - 1;
+        }
+
+    free(slot);
+    *mask_out  = mask;
+    *piece_out = piece;
+    *keys_out  = keys;
+    return key_of;
+}
+
+typedef struct {
+    uint32_t      key;
+    SolIndexChunk c;
+} KeyChunk;
+
+int solindex_build(const SolMap *sm, SolIndex *ix)
+{
+    memset(ix, 0, sizeof *ix);
+    uint64_t *key_mask;
+    uint8_t  *key_piece;
+    uint32_t  keys;
+    uint32_t *key_of = build_keys(sm, &key_mask, &key_piece, &keys);
+
+    uint64_t count = sm->h->count;
+    uint32_t *cnt  = calloc(keys + 1, sizeof *cnt);
+    uint16_t *low  = malloc((size_t)NUM_PIECES * CHUNK_IDS * sizeof *low);
+    uint32_t *rkey = malloc((size_t)NUM_PIECES * CHUNK_IDS * sizeof *rkey);
+
+    KeyChunk *kc = NULL;
+    size_t nkc = 0, kc_cap = 0;
+    uint16_t *pool = NULL;
+    size_t pool_len = 0, pool_cap = 0;
+
+    /* Chunk by chunk: bucket the (key, low ID) pairs of 2^16 records by
+       key, then emit one array or bitmap chunk per key present. */
+    for (uint64_t base = 0; base < count; base += CHUNK_IDS) {
+        uint32_t m = (uint32_t)(count - base < CHUNK_IDS ? count - base : CHUNK_IDS);
+        memset(cnt, 0, (keys + 1) * sizeof *cnt);
+
+        int n = 0;
+        for (uint32_t r = 0; r < m; ++r) {
+            const uint16_t *rec = sm->rec + (base + r) * (NUM_PIECES + 1);
+            for (int p = 0; p < NUM_PIECES; ++p) {
+                uint32_t k = key_of[4*rec[p] + rec[NUM_PIECES]];
+                rkey[n++] = k;
+                ++cnt[k + 1];
+            }
+        }
+        for (uint32_t k = 0; k < keys; ++k) cnt[k+1] += cnt[k];
+        for (int i = 0; i < n; ++i)
+            low[cnt[rkey[i]]++] = (uint16_t)(i / NUM_PIECES);
+
+        /* cnt[k] now ends key k's run, which starts where key k-1's ends */
+        for (uint32_t k = 0, start = 0; k < keys; start = cnt[k++]) {
+            uint32_t card = cnt[k] - start;
+            if (!card) continue;
+
+            size_t need = card > SOLINDEX_ARRAY_MAX ? BITMAP_LEN + 3 : card;
+            if (pool_len + need > pool_cap) {
+                pool_cap = 2 * (pool_len + need);
+                pool = realloc(pool, pool_cap * sizeof *pool);
+            }
+            if (nkc == kc_cap) {
+                kc_cap = kc_cap ? 2 * kc_cap : 1024;
+                kc = realloc(kc, kc_cap * sizeof *kc);
+            }
+
+            KeyChunk *c = &kc[nkc++];
+            c->key = k;
+            c->c.hi = (uint16_t)(base >> 16);
+            c->c.reserved = 0;
+            c->c.card = card;
+            if (card > SOLINDEX_ARRAY_MAX) {
+                pool_len = (pool_len + 3) & ~(size_t)3;
+                uint64_t *bits = (uint64_t *)(pool + pool_len);
+                memset(bits, 0, CHUNK_IDS / 8);
+                for (uint32_t i = start; i < cnt[k]; ++i)
+                    bits[low[i] >> 6] |= 1ULL << (low[i] & 63);
+                c->c.offset = pool_len;
+                pool_len += BITMAP_LEN;
+            } else {
+                memcpy(pool + pool_len, low + start, card * sizeof *pool);
+                c->c.offset = pool_len;
+                pool_len += card;
+            }
+        }
+    }
+
+    /* regroup the chunks by key; within a key they stay in ID order */
+    uint32_t *first = calloc(keys + 1, sizeof *first);
+    for (size_t i = 0; i < nkc; ++i) ++first[kc[i].key + 1];
+    for (uint32_t k = 0; k < keys; ++k) first[k+1] += first[k];
+    SolIndexChunk *chunk = malloc((nkc ? nkc : 1) * sizeof *chunk);
+    uint32_t *fill = malloc((keys + 1) * sizeof *fill);
+    memcpy(fill, first, (keys + 1) * sizeof *fill);
+    for (size_t i = 0; i < nkc; ++i) chunk[fill[kc[i].key]++] = kc[i].c;
+
+    memcpy(ix->h.magic, SOLINDEX_MAGIC, 4);
+    ix->h.version   = SOLINDEX_VERSION;
+    ix->h.solutions = count;
+    ix->h.keys      = keys;
+    ix->h.chunks    = (uint32_t)nkc;
+    ix->h.pool      = pool_len;
+    ix->key_mask  = key_mask;
+    ix->key_piece = key_piece;
+    ix->key_first = first;
+    ix->chunk     = chunk;
+    ix->pool      = pool;
+    sort_keys(ix);
+
+    free(fill);
+    free(kc);
+    free(rkey);
+    free(low);
+    free(cnt);
+    free(key_of);
+    return 0;
+}
+
+static int put(FILE *f, const void *p, size_t n)
+{
+    static const char zero[8];
+    return fwrite(p, 1, n, f) == n &&
+           fwrite(zero, 1, pad8(n) - n, f) == pad8(n) - n ? 0 : -1;
+}
+
+int solindex_write(const SolIndex *ix, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) { perror(path); return -1; }
+    int rc = put(f, &ix->h, sizeof ix->h) ||
+             put(f, ix->key_mask, ix->h.keys * sizeof *ix->key_mask) ||
+             put(f, ix->key_piece, ix->h.keys) ||
+             put(f, ix->key_first, (ix->h.keys + 1) * sizeof *ix->key_first) ||
+             put(f, ix->chunk, ix->h.chunks * sizeof *ix->chunk) ||
+             put(f, ix->pool, ix->h.pool * sizeof *ix->pool);
+    if (fclose(f) != 0) rc = -1;
+    if (rc) perror(path);
+    return rc ? -1 : 0;
+}
+
+int solindex_open(const char *path, SolIndex *ix)
+{
+    memset(ix, 0, sizeof *ix);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return -1; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof ix->h) {
+        fprintf(stderr, "%s: not a solution index\n", path);
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) { perror(path); return -1; }
+
+    const char *p = base;
+    memcpy(&ix->h, p, sizeof ix->h);
+    size_t off = pad8(sizeof ix->h);
+    size_t o_mask  = off;  off += pad8(ix->h.keys * sizeof(uint64_t));
+    size_t o_piece = off;  off += pad8(ix->h.keys);
+    size_t o_first = off;  off += pad8((ix->h.keys + 1) * sizeof(uint32_t));
+    size_t o_chunk = off;  off += ix->h.chunks * sizeof(SolIndexChunk);
+    size_t o_pool  = off;  off += ix->h.pool * sizeof(uint16_t);
+
+    if (memcmp(ix->h.magic, SOLINDEX_MAGIC, 4) != 0 ||
+        ix->h.version != SOLINDEX_VERSION || off > (size_t)st.st_size) {
+        fprintf(stderr, "%s: not a solution index\n", path);
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    ix->key_mask  = (const uint64_t *)(p + o_mask);
+    ix->key_piece = (const uint8_t *)(p + o_piece);
+    ix->key_first = (const uint32_t *)(p + o_first);
+    ix->chunk     = (const SolIndexChunk *)(p + o_chunk);
+    ix->pool      = (const uint16_t *)(p + o_pool);
+    ix->map       = base;
+    ix->map_size  = st.st_size;
+    sort_keys(ix);
+    return 0;
+}
+
+void solindex_free(SolIndex *ix)
+{
+    if (ix->map) {
+        munmap(ix->map, ix->map_size);
+    } else {
+        free((void *)ix->key_mask);
+        free((void *)ix->key_piece);
+        free((void *)ix->key_first);
+        free((void *)ix->chunk);
+        free((void *)ix->pool);
+    }
+    free(ix->by_mask);
+    memset(ix, 0, sizeof *ix);
+}
+
+size_t solindex_bytes(const SolIndex *ix)
+{
+    return pad8(sizeof ix->h) + pad8(ix->h.keys * sizeof(uint64_t)) +
+           pad8(ix->h.keys) + pad8((ix->h.keys + 1) * sizeof(uint32_t)) +
+           ix->h.chunks * sizeof(SolIndexChunk) +
+           ix->h.pool * sizeof(uint16_t);
+}
+
+uint64_t solindex_card(const SolIndex *ix, int key)
+{
+    uint64_t card = 0;
+    for (uint32_t c = ix->key_first[key]; c < ix->key_first[key+1]; ++c)
+        card += ix->chunk[c].card;
+    return card;
+}
+
+static int is_bitmap(const SolIndexChunk *c)
+{
+    return c->card > SOLINDEX_ARRAY_MAX;
+}
+
+/* Keeps the IDs of cand[0..n-1] that are also in chunk c. */
+static int filter(const SolIndex *ix, const SolIndexChunk *c,
+                  uint16_t *cand, int n)
+{
+    const uint16_t *a = ix->pool + c->offset;
+    int out = 0;
+    if (is_bitmap(c)) {
+        const uint64_t *bits = (const uint64_t *)a;
+        for (int i = 0; i < n; ++i)
+            if (bits[cand[i] >> 6] >> (cand[i] & 63) & 1) cand[out++] = cand[i];
+        return out;
+    }
+    int m = (int)c->card;
+    for (int i = 0, j = 0; i < n && j < m; ) {
+        if (cand[i] < a[j])      ++i;
+        else if (cand[i] > a[j]) ++j;
+        else { cand[out++] = cand[i]; ++i; ++j; }
+    }
+    return out;
+}
+
+static int cmp_card(const void *a, const void *b)
+{
+    uint64_t x = ((const uint64_t *)a)[0], y = ((const uint64_t *)b)[0];
+    return (x > y) - (x < y);
+}
+
+uint64_t solindex_query(const SolIndex *ix, const int *keys, int n,
+                        uint32_t *ids, uint64_t max_ids)
+{
+    if (n == 0) {
+        for (uint64_t i = 0; i < max_ids && i < ix->h.solutions; ++i)
+            ids[i] = (uint32_t)i;
+        return ix->h.solutions;
+    }
+
+    /* terms by increasing cardinality: (card, key) pairs */
+    uint64_t term[2*NUM_PIECES];
+    uint32_t cur[NUM_PIECES], end[NUM_PIECES];
+    if (n > NUM_PIECES) n = NUM_PIECES;
+    for (int t = 0; t < n; ++t) {
+        term[2*t]   = solindex_card(ix, keys[t]);
+        term[2*t+1] = keys[t];
+    }
+    qsort(term, n, 2 * sizeof *term, cmp_card);
+    for (int t = 0; t < n; ++t) {
+        cur[t] = ix->key_first[term[2*t+1]];
+        end[t] = ix->key_first[term[2*t+1] + 1];
+    }
+
+    static _Thread_local uint16_t cand[CHUNK_IDS];
+    static _Thread_local uint64_t bits[CHUNK_IDS / 64];
+    uint64_t found = 0;
+
+    for (; cur[0] < end[0]; ++cur[0]) {
+        const SolIndexChunk *ch[NUM_PIECES];
+        uint16_t hi = ix->chunk[cur[0]].hi;
+        int best = 0, missing = 0;
+        ch[0] = &ix->chunk[cur[0]];
+        for (int t = 1; t < n && !missing; ++t) {
+            while (cur[t] < end[t] && ix->chunk[cur[t]].hi < hi) ++cur[t];
+            if (cur[t] == end[t] || ix->chunk[cur[t]].hi != hi) missing = 1;
+            else if ((ch[t] = &ix->chunk[cur[t]])->card < ch[best]->card) best = t;
+        }
+        if (missing) continue;
+
+        int m;
+        if (!is_bitmap(ch[best])) {
+            m = (int)ch[best]->card;
+            memcpy(cand, ix->pool + ch[best]->offset, m * sizeof *cand);
+            for (int t = 0; t < n && m; ++t)
+                if (t != best) m = filter(ix, ch[t], cand, m);
+        } else {
+            /* every chunk is a bitmap */
+            memcpy(bits, ix->pool + ch[0]->offset, sizeof bits);
+            for (int t = 1; t < n; ++t) {
+                const uint64_t *b = (const uint64_t *)(ix->pool + ch[t]->offset);
+                for (int w = 0; w < CHUNK_IDS / 64; ++w) bits[w] &= b[w];
+            }
+            m = 0;
+            for (int w = 0; w < CHUNK_IDS / 64; ++w)
+                for (uint64_t x = bits[w]; x; x &= x-1)
+                    cand[m++] = (uint16_t)(64*w + __builtin_ctzll(x));
+        }
+
+        for (int i = 0; i < m && found + i < max_ids; ++i)
+            ids[found + i] = (uint32_t)hi << 16 | cand[i];
+        found += m;
+    }
+    return found;
+}
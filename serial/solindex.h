@@ -0,0 +1,87 @@
+#ifndef SOLINDEX_H
+#define SOLINDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "init.h"
+#include "solfile.h"
+
+/* Inverted index over a solutions.bin: one compressed bitmap of solution
+   IDs (0-based record numbers) per placement. Keys 0..place_cnt-1 are the
+   placements of the file's table; the mirror images and rotations of
+   those placements, which the non-canonical solutions use, follow.
+
+   A bitmap is split into chunks of 2^16 IDs. A chunk holding at most
+   SOLINDEX_ARRAY_MAX IDs stores their low 16 bits as a sorted array, a
+   denser one as a 65536-bit bitmap.
+
+   File layout (solutions.iqx, host byte order):
+     SolIndexHeader
+     uint64_t      key_mask[keys]
+     uint8_t       key_piece[keys]     padded with zeros to a multiple of 8
+     uint32_t      key_first[keys+1]   padded likewise; chunks of key k are
+                                       chunk[key_first[k] .. key_first[k+1]-1]
+     SolIndexChunk chunk[chunks]
+     uint16_t      pool[pool]          chunk contents */
+
+#define SOLINDEX_MAGIC     "IQFX"
+#define SOLINDEX_VERSION   1
+#define SOLINDEX_ARRAY_MAX 4096
+
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint64_t solutions;
+    uint32_t keys;
+    uint32_t chunks;
+    uint64_t pool;
+} SolIndexHeader;
+
+typedef struct {
+    uint16_t hi;        /* solution ID >> 16 */
+    uint16_t reserved;
+    uint32_t card;      /* bitmap when > SOLINDEX_ARRAY_MAX */
+    uint64_t offset;    /* into pool, 8-byte aligned for bitmaps */
+} SolIndexChunk;
+
+/* A solutions.bin mapped into memory. */
+typedef struct {
+    const SolFileHeader *h;
+    const uint64_t      *mask;      /* the file's placement table */
+    const uint8_t       *piece;
+    const uint16_t      *rec;       /* h->count records of pieces+1 entries */
+    void                *map;
+    size_t               size;
+} SolMap;
+
+typedef struct {
+    SolIndexHeader       h;
+    const uint64_t      *key_mask;
+    const uint8_t       *key_piece;
+    const uint32_t      *key_first;
+    const SolIndexChunk *chunk;
+    const uint16_t      *pool;
+    uint32_t            *by_mask;   /* keys sorted by mask, for lookups */
+    void                *map;       /* mapped file, or NULL when built */
+    size_t               map_size;
+} SolIndex;
+
+int      solmap_open(const char *path, SolMap *sm);
+void     solmap_close(SolMap *sm);
+
+int      solindex_build(const SolMap *sm, SolIndex *ix);
+int      solindex_write(const SolIndex *ix, const char *path);
+int      solindex_open(const char *path, SolIndex *ix);
+void     solindex_free(SolIndex *ix);
+size_t   solindex_bytes(const SolIndex *ix);
+
+/* Key of piece pid covering mask, or -1 if the index has no such key. */
+int      solindex_key(const SolIndex *ix, uint64_t mask, int pid);
+uint64_t solindex_card(const SolIndex *ix, int key);
+
+/* Solutions using every one of the n keys. The first max_ids IDs, in
+   increasing order, are stored in ids (which may be NULL). */
+uint64_t solindex_query(const SolIndex *ix, const int *keys, int n,
+                        uint32_t *ids, uint64_t max_ids);
+
+#endif
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iqfit.h"
+#include "solrank.h"
+
+/* FNV-1a over the placement masks. */
+static uint64_t place_hash(void)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < place_cnt; ++i) {
+        h ^= place[i].mask;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+int rank_table_write(const char *path, const PrefixList *pl,
+                     const uint64_t *boards)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) { perror(path); return -1; }
+
+    RankHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, RANK_MAGIC, 4);
+    h.version    = RANK_VERSION;
+    h.depth      = pl->depth;
+    h.place_cnt  = place_cnt;
+    h.place_hash = place_hash();
+    for (int i = 0; i < pl->cnt; ++i) {
+        h.prefixes += boards[i] > 0;
+        h.boards   += boards[i];
+    }
+    int rc = fwrite(&h, sizeof h, 1, f) == 1 ? 0 : -1;
+
+    uint32_t first = 0;
+    for (int i = 0; i < pl->cnt && rc == 0; ++i) {
+        if (!boards[i]) continue;
+        if (fwrite(&first, sizeof first, 1, f) != 1 ||
+            fwrite(pl->items[i].idx, sizeof(uint16_t), pl->depth, f) != (size_t)pl->depth)
+            rc = -1;
+        first += (uint32_t)boards[i];
+    }
+    if (fclose(f) != 0) rc = -1;
+    if (rc != 0) perror(path);
+    return rc;
+}
+
+static int read_record(FILE *f, int depth, uint64_t r, uint32_t *first,
+                       uint16_t idx[MAX_PREFIX_DEPTH])
+{
+    long rec = (long)(sizeof *first + depth * sizeof *idx);
+    return fseek(f, (long)sizeof(RankHeader) + (long)r * rec, SEEK_SET) == 0 &&
+           fread(first, sizeof *first, 1, f) == 1 &&
+           fread(idx, sizeof *idx, depth, f) == (size_t)depth ? 0 : -1;
+}
+
+int rank_table_board(const char *path, uint64_t n, char board[BOARD_CELLS],
+                     RankInfo *info)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return -1; }
+
+    RankHeader h;
+    if (fread(&h, sizeof h, 1, f) != 1 || memcmp(h.magic, RANK_MAGIC, 4) ||
+        h.version != RANK_VERSION || h.depth < 1 || h.depth > MAX_PREFIX_DEPTH) {
+        fprintf(stderr, "%s: not a rank table\n", path);
+        fclose(f);
+        return -1;
+    }
+    if (h.place_cnt != (uint32_t)place_cnt || h.place_hash != place_hash()) {
+        fprintf(stderr, "%s: built for other placement tables\n", path);
+        fclose(f);
+        return -1;
+    }
+    info->boards = h.boards;
+    info->depth  = (int)h.depth;
+    info->nodes  = 0;
+    if (n < 1 || n > h.boards) {
+        fclose(f);
+        return 1;
+    }
+
+    /* the last prefix whose first board is at most n-1 */
+    uint64_t t = n - 1, lo = 0, hi = h.prefixes;
+    uint32_t first;
+    uint16_t idx[MAX_PREFIX_DEPTH];
+    while (hi - lo > 1) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (read_record(f, h.depth, mid, &first, idx) != 0) goto bad;
+        if (first <= t) lo = mid; else hi = mid;
+    }
+    if (read_record(f, h.depth, lo, &first, idx) != 0) goto bad;
+    fclose(f);
+
+    IqSolver *s = iq_solver_create(iq_tables(), NULL, NULL, NULL);
+    uint64_t occ_piece[NUM_PIECES], left = t - first;
+    int found = 0;
+    iq_solver_start_prefix(s, idx, h.depth);
+    while (!found && iq_next_solution(s, occ_piece)) {
+        uint16_t id[NUM_PIECES];
+        int sym[4];
+        solution_ids(occ_piece, id);
+        uint64_t k = (uint64_t)solution_variants_ids(id, sym);
+        if (left < k) {
+            solution_board(id, sym[left], board);
+            found = 1;
+        } else {
+            left -= k;
+        }
+    }
+    info->nodes = iq_solver_nodes(s);
+    iq_solver_free(s);
+    if (!found) {
+        fprintf(stderr, "%s: board %llu is not where the table says\n",
+                path, (unsigned long long)n);
+        return -1;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "%s: truncated\n", path);
+    fclose(f);
+    return -1;
+}
@@ -0,0 +1,51 @@
+#ifndef SOLRANK_H
+#define SOLRANK_H
+
+#include <stdint.h>
+#include "init.h"
+#include "worklist.h"
+
+/* Rank table: finds board n of the solver's output without the output.
+
+   The single-threaded solver writes the solutions of each depth-D prefix
+   of enum_prefixes() one after the other, each canonical solution followed
+   by its variants (solution_variants_ids()). The table holds, for every
+   prefix with at least one solution, the number of boards written before
+   it. Board n is then found by a binary search for its prefix and a
+   search of that one subtree, counting boards until the n-th.
+
+     RankHeader
+     records                       prefixes * (4 + 2 * depth) bytes
+   A record is a uint32_t board count followed by uint16_t idx[depth], the
+   prefix's placements. Fields are in host byte order, as in solfile.h. */
+
+#define RANK_MAGIC   "IQRK"
+#define RANK_VERSION 1
+
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint32_t depth;
+    uint32_t place_cnt;
+    uint64_t place_hash;        /* of place[], which idx[] refers to */
+    uint64_t prefixes;          /* records */
+    uint64_t boards;            /* all solutions, with their variants */
+} RankHeader;
+
+typedef struct {
+    uint64_t boards;            /* in the whole table */
+    int      depth;
+    uint64_t nodes;             /* searched for this board */
+} RankInfo;
+
+/* Writes the table for pl, whose prefix i has boards[i] boards below it. */
+int rank_table_write(const char *path, const PrefixList *pl,
+                     const uint64_t *boards);
+
+/* Board n (1-based) into board, as solution_board() draws it. Needs
+   iq_tables(). Returns 0, 1 if n is past the last board, or -1 (with a
+   message) if the table cannot be read or belongs to other tables. */
+int rank_table_board(const char *path, uint64_t n, char board[BOARD_CELLS],
+                     RankInfo *info);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef WORKLIST_H
+#define WORKLIST_H
+
+#include <stdint.h>
+#include "init.h"
+
+#define MAX_PREFIX_DEPTH 6
+
+typedef struct {
+    uint16_t idx[MAX_PREFIX_DEPTH];
+    int      shard;
+    double   est;
+} Prefix;
+
+typedef struct {
+    Prefix *items;
+    int     cnt, cap;
+    int     depth;
+    int     shards;
+} PrefixList;
+
+void   enum_prefixes(PrefixList *pl, int depth);
+void   prefix_state(const Prefix *pf, int depth, uint64_t *occ,
+                    uint32_t *used_mask, uint64_t occ_piece[NUM_PIECES]);
+double estimate_subtree(uint64_t occ, uint32_t used_mask, int probes,
+                        uint64_t *rng);
+void   partition_prefixes(PrefixList *pl, int shards, int probes);
+
+int  write_worklist(const char *path, const PrefixList *pl);
+int  read_worklist(const char *path, int shard, PrefixList *pl);
+void free_prefixes(PrefixList *pl);
+
+#endif
@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "writer.h"
+#include "solfile.h"
+
+#define RING_SIZE  (1u << 15)
+#define BUF_SIZE   (4u << 20)
+#define MAX_FORMAT (4 * (32 + BOARD_H * (2*BOARD_W + 1) + 11))
+
+typedef struct {
+    uint64_t m[NUM_PIECES];
+} RawSolution;
+
+struct Writer {
+    RawSolution     *ring;
+    _Atomic uint64_t head;          /* next slot the producer fills */
+    _Atomic uint64_t tail;          /* next slot the consumer drains */
+    atomic_int       done;
+    pthread_t        thread;
+
+    int      fd, binary, expand, error;
+    char    *buf;
+    size_t   len;
+
+    uint64_t solutions, bytes, writes;
+    uint64_t stalls;
+    double   stall_sec;
+};
+
+static double now(void)
+{
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+static void flush_buf(Writer *w)
+{
+    size_t off = 0;
+    while (off < w->len) {
+        ssize_t n = write(w->fd, w->buf + off, w->len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            w->error = errno;
+            break;
+        }
+        off += n;
+        ++w->writes;
+    }
+    w->bytes += off;
+    w->len = 0;
+}
+
+static char *put_u64(char *p, uint64_t v)
+{
+    char tmp[20];
+    int n = 0;
+    do { tmp[n++] = '0' + v % 10; v /= 10; } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+static void format_solution(Writer *w, const RawSolution *s)
+{
+    uint16_t rec[NUM_PIECES+1];
+    int sym[4] = { SYM_ID };
+    solution_ids(s->m, rec);
+    int n = w->expand ? solution_variants_ids(rec, sym) : 1;
+
+    if (w->binary) {
+        for (int i = 0; i < n; ++i) {
+            rec[NUM_PIECES] = (uint16_t)sym[i];
+            memcpy(w->buf + w->len, rec, sizeof rec);
+            w->len += sizeof rec;
+        }
+        w->solutions += n;
+        return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        char B[BOARD_CELLS];
+        solution_board(rec, sym[i], B);
+
+        char *p = w->buf + w->len;
+        memcpy(p, "Solution ", 9); p += 9;
+        p = put_u64(p, ++w->solutions);
+        *p++ = ':'; *p++ = '\n';
+        for (int r = 0; r < BOARD_H; ++r) {
+            for (int c = 0; c < BOARD_W; ++c) {
+                *p++ = B[r*BOARD_W+c];
+                *p++ = ' ';
+            }
+            *p++ = '\n';
+        }
+        memcpy(p, "==========\n", 11); p += 11;
+        w->len = p - w->buf;
+    }
+}
+
+static void *writer_main(void *arg)
+{
+    Writer *w = arg;
+
+    for (;;) {
+        uint64_t t = atomic_load_explicit(&w->tail, memory_order_relaxed);
+        uint64_t h = atomic_load_explicit(&w->head, memory_order_acquire);
+
+        if (t == h) {
+            if (atomic_load_explicit(&w->done, memory_order_acquire) &&
+                t == atomic_load_explicit(&w->head, memory_order_acquire))
+                break;
+            struct timespec ts = { 0, 100000 };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        for (; t != h; ++t) {
+            if (BUF_SIZE - w->len < MAX_FORMAT) flush_buf(w);
+            format_solution(w, &w->ring[t & (RING_SIZE-1)]);
+            /* release slots in batches so the producer sees progress */
+            if ((t & 255) == 255)
+                atomic_store_explicit(&w->tail, t+1, memory_order_release);
+        }
+        atomic_store_explicit(&w->tail, t, memory_order_release);
+    }
+
+    flush_buf(w);
+    return NULL;
+}
+
+Writer *writer_open(int fd, int binary, int expand)
+{
+    Writer *w = calloc(1, sizeof *w);
+    w->ring   = malloc(RING_SIZE * sizeof *w->ring);
+    w->buf    = malloc(BUF_SIZE);
+    w->fd     = fd;
+    w->binary = binary;
+    w->expand = expand;
+    atomic_init(&w->head, 0);
+    atomic_init(&w->tail, 0);
+    atomic_init(&w->done, 0);
+
+    if (!w->ring || !w->buf ||
+        pthread_create(&w->thread, NULL, writer_main, w) != 0) {
+        free(w->ring);
+        free(w->buf);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void writer_push(Writer *w, const uint64_t occ_piece[NUM_PIECES])
+{
+    uint64_t h = atomic_load_explicit(&w->head, memory_order_relaxed);
+
+    if (h - atomic_load_explicit(&w->tail, memory_order_acquire) == RING_SIZE) {
+        double t0 = now();
+        ++w->stalls;
+        while (h - atomic_load_explicit(&w->tail, memory_order_acquire) == RING_SIZE)
+            sched_yield();
+        w->stall_sec += now() - t0;
+    }
+
+    memcpy(w->ring[h & (RING_SIZE-1)].m, occ_piece, sizeof(RawSolution));
+    atomic_store_explicit(&w->head, h+1, memory_order_release);
+}
+
+/* Drains the ring, joins the writer thread and frees it. Returns 0 on
+   success or the errno of the first failed write(). */
+int writer_close(Writer *w, WriterStats *st)
+{
+    atomic_store_explicit(&w->done, 1, memory_order_release);
+    pthread_join(w->thread, NULL);
+
+    if (st) {
+        st->solutions = w->solutions;
+        st->bytes     = w->bytes;
+        st->writes    = w->writes;
+        st->stalls    = w->stalls;
+        st->stall_sec = w->stall_sec;
+    }
+    int err = w->error;
+    free(w->ring);
+    free(w->buf);
+    free(w);
+    return err;
+}
@@ -0,0 +1,27 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stdint.h>
+#include "init.h"
+
+/* Asynchronous solution writer: the search thread pushes the piece masks
+   of each canonical solution into a single-producer/single-consumer ring;
+   a dedicated thread expands the symmetric variants (unless expand is 0),
+   formats them (text or solfile records) and writes large blocks to fd
+   with write(). */
+
+typedef struct Writer Writer;
+
+typedef struct {
+    uint64_t solutions;     /* boards written, all symmetries */
+    uint64_t bytes;
+    uint64_t writes;        /* write() calls */
+    uint64_t stalls;        /* pushes that found the ring full */
+    double   stall_sec;     /* time the search thread spent waiting */
+} WriterStats;
+
+Writer  *writer_open(int fd, int binary, int expand);
+void     writer_push(Writer *w, const uint64_t occ_piece[NUM_PIECES]);
+int      writer_close(Writer *w, WriterStats *st);
+
+#endif
@@ -1,8 +1,16 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
+#include "serial/solfile.h"
+#include "serial/iqfit.h"
+#include "serial/solrank.h"
 
 #define RESET "\033[0m"
 #define YELLOW "\033[48;5;226m  \033[0m"     // Y - Bright Yellow
@@ -125,6 +133,21 @@ int isIndexStale(const char* solutions_path, const char* index_path) {
     return 0;
 }
 
+/* The binary file is used unless solutions.txt was written after it. */
+int preferBinary(const char* binary_path, const char* solutions_path) {
+    struct stat binary_stat, solutions_stat;
+
+    if (stat(binary_path, &binary_stat) != 0) {
+        return 0;
+    }
+
+    if (stat(solutions_path, &solutions_stat) != 0) {
+        return 1;
+    }
+
+    return binary_stat.st_mtime >= solutions_stat.st_mtime;
+}
+
 long getSolutionPosition(int solution_num, const char* index_path) {
     FILE *index = fopen(index_path, "rb");
     if (!index) return -1;
@@ -144,32 +167,178 @@ long getSolutionPosition(int solution_num, const char* index_path) {
     return position;
 }
 
+typedef struct {
+    const unsigned char *base;
+    size_t size;
+    const SolFileHeader *header;
+    const uint64_t *masks;
+    const unsigned char *records;
+} BinarySolutions;
+
+int openBinarySolutions(const char* path, BinarySolutions *bs) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SolFileHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return 0;
+
+    bs->base = base;
+    bs->size = st.st_size;
+    bs->header = (const SolFileHeader *)base;
+    bs->masks = (const uint64_t *)(bs->base + sizeof(SolFileHeader));
+    bs->records = bs->base + solfile_data_offset(bs->header);
+
+    const SolFileHeader *h = bs->header;
+    if (memcmp(h->magic, SOLFILE_MAGIC, 4) != 0 || h->version != SOLFILE_VERSION ||
+        h->board_w != 11 || h->board_h != 5 || h->pieces > 16 ||
+        h->record_size != (h->pieces + 1) * sizeof(uint16_t) ||
+        solfile_data_offset(h) + h->count * h->record_size > bs->size) {
+        printf("Error: %s is not a valid solutions file\n", path);
+        munmap(base, st.st_size);
+        return 0;
+    }
+    return 1;
+}
+
+void readBinarySolution(const BinarySolutions *bs, uint64_t solution_num, char grid[5][11]) {
+    const SolFileHeader *h = bs->header;
+    uint16_t rec[17];
+    memcpy(rec, bs->records + (solution_num - 1) * h->record_size, h->record_size);
+    int sym = rec[h->pieces];
+
+    for (int p = 0; p < h->pieces; ++p) {
+        if (rec[p] >= h->place_cnt) continue;
+        uint64_t m = bs->masks[rec[p]];
+        for (int bit = 0; bit < 55; ++bit) {
+            if (!(m >> bit & 1)) continue;
+            int r = bit / 11, c = bit % 11;
+            if (sym == SYM_HFLIP || sym == SYM_ROT180) c = 10 - c;
+            if (sym == SYM_VFLIP || sym == SYM_ROT180) r = 4 - r;
+            grid[r][c] = h->piece_sym[p];
+        }
+    }
+}
+
+int showBinarySolution(const char* path, long solution_num) {
+    BinarySolutions bs;
+    if (!openBinarySolutions(path, &bs)) return 0;
+
+    if (solution_num > (long)bs.header->count) {
+        fprintf(stderr, "Error: Solution number must be between 1 and %llu\n",
+                (unsigned long long)bs.header->count);
+        munmap((void *)bs.base, bs.size);
+        return -1;
+    }
+
+    char grid[5][11];
+    memset(grid, '.', sizeof(grid));
+    readBinarySolution(&bs, solution_num, grid);
+    munmap((void *)bs.base, bs.size);
+
+    printf("\nFound Solution %ld from %s:\n", solution_num, path);
+    printf("==================================\n");
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 11; j++) {
+            printf("%c ", grid[i][j]);
+        }
+        printf("\n");
+    }
+
+    printColoredGrid(grid);
+    printLegend();
+    return 1;
+}
+
+/* Computes the solution from the rank table instead of reading it. */
+int showRankedSolution(const char* path, long solution_num) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    iq_tables();
+
+    char board[BOARD_CELLS];
+    RankInfo info;
+    int rc = rank_table_board(path, solution_num, board, &info);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (rc < 0) return 0;
+    if (rc > 0) {
+        fprintf(stderr, "Error: Solution number must be between 1 and %llu\n",
+                (unsigned long long)info.boards);
+        return 0;
+    }
+
+    char grid[5][11];
+    memcpy(grid, board, sizeof(grid));
+
+    printf("\nComputed Solution %ld from %s:\n", solution_num, path);
+    printf("==================================\n");
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 11; j++) {
+            printf("%c ", grid[i][j]);
+        }
+        printf("\n");
+    }
+    printf("(%llu search nodes below a depth-%d prefix, %.2f ms)\n",
+           (unsigned long long)info.nodes, info.depth,
+           (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+    printColoredGrid(grid);
+    printLegend();
+    return 1;
+}
 
 int main(int argc, char *argv[]) {
     if (argc != 3) {
-        fprintf(stderr, "Usage: %s <s|m> <solution_number>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <s|m|r> <solution_number>\n", argv[0]);
         fprintf(stderr, "  s: Use 'serial/solutions.txt'\n");
         fprintf(stderr, "  m: Use 'mpi/solutions.txt'\n");
+        fprintf(stderr, "  r: Compute it from 'serial/solutions.rank'\n");
         return 1;
     }
 
     const char* mode_arg = argv[1];
-    if (strcmp(mode_arg, "s") != 0 && strcmp(mode_arg, "m") != 0) {
-        fprintf(stderr, "Error: Invalid mode '%s'. Please use 's' for serial or 'm' for mpi.\n", mode_arg);
+    if (strcmp(mode_arg, "s") != 0 && strcmp(mode_arg, "m") != 0 &&
+        strcmp(mode_arg, "r") != 0) {
+        fprintf(stderr, "Error: Invalid mode '%s'. Please use 's' for serial, 'm' for mpi or 'r' for the rank table.\n", mode_arg);
         return 1;
     }
 
     int solution_num = atoi(argv[2]);
-    if (solution_num < 1 || solution_num > 4331140) {
-        fprintf(stderr, "Error: Solution number must be between 1 and 4331140\n");
+    if (solution_num < 1) {
+        fprintf(stderr, "Error: Solution number must be at least 1\n");
         return 1;
     }
 
+    if (strcmp(mode_arg, "r") == 0) {
+        return showRankedSolution("serial/solutions.rank", solution_num) ? 0 : 1;
+    }
+
     const char* folder = (strcmp(mode_arg, "s") == 0) ? "serial" : "mpi";
     char solutions_path[256];
     char index_path[256];
+    char binary_path[256];
     sprintf(solutions_path, "%s/solutions.txt", folder);
     sprintf(index_path, "%s/solutions.idx", folder);
+    sprintf(binary_path, "%s/solutions.bin", folder);
+
+    /* the binary file needs no index: records have a fixed size */
+    if (preferBinary(binary_path, solutions_path)) {
+        int shown = showBinarySolution(binary_path, solution_num);
+        if (shown != 0) {
+            return shown > 0 ? 0 : 1;
+        }
+    }
+
+    if (solution_num > 4331140) {
+        fprintf(stderr, "Error: Solution number must be between 1 and 4331140\n");
+        return 1;
+    }
 
     int stale_status = isIndexStale(solutions_path, index_path);
     if (stale_status == -1) {